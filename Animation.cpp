@@ -0,0 +1,141 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+
+#include "Animation.h"
+#include "Profiler.h"
+
+// pieces cross the board at this speed (world units per second), but never
+// take less than the minimum time to arrive
+static const double piece_speed = 0.5;
+static const double piece_minimum_duration = 0.2;
+
+PieceTween::PieceTween(osg::PositionAttitudeTransform *target_, const osg::Vec3d &destination_, double arc_height_) :
+    Tween(target_), destination(destination_), arc_height(arc_height_)
+{}
+
+bool PieceTween::update(double time)
+{
+    osg::ref_ptr<osg::PositionAttitudeTransform> patt;
+    if (!target.lock(patt))
+        return false;
+
+    if (start_time < 0.)
+    {
+        // start from wherever the piece is now (it may have been
+        // interrupted in the middle of another move)
+        start_time = time;
+        origin = patt->getPosition();
+        duration = std::max(piece_minimum_duration, (destination - origin).length() / piece_speed);
+    }
+
+    auto t = std::min(1., (time - start_time) / duration);
+    auto eased = t * t * (3. - 2. * t); // smoothstep
+
+    auto position = origin + (destination - origin) * eased;
+    position.z() += arc_height * 4. * t * (1. - t);
+
+    patt->setPosition(position);
+
+    return t < 1.;
+}
+
+SpinTween::SpinTween(osg::PositionAttitudeTransform *target_, const osg::Vec3d &axis_, double radians_per_second_) :
+    Tween(target_), axis(axis_), radians_per_second(radians_per_second_)
+{}
+
+bool SpinTween::update(double time)
+{
+    osg::ref_ptr<osg::PositionAttitudeTransform> patt;
+    if (!target.lock(patt))
+        return false;
+
+    if (start_time < 0.)
+        start_time = time;
+
+    auto angle = std::fmod(radians_per_second * (time - start_time), 2. * M_PI);
+    patt->setAttitude(osg::Quat(angle, axis));
+
+    return true; // spins until removed
+}
+
+Animator::Animator(osg::Node *host_) : host(host_) {}
+
+void Animator::add(Tween *tween)
+{
+    remove(tween->get_target());
+    tweens.push_back(tween);
+    attach();
+}
+
+void Animator::remove(osg::Node *target)
+{
+    tweens.erase(std::remove_if(tweens.begin(), tweens.end(),
+                                [target](const TweenPtr &tween) { return tween->get_target() == target; }),
+                 tweens.end());
+}
+
+void Animator::attach()
+{
+    osg::ref_ptr<osg::Node> node;
+    if (attached || !host.lock(node))
+        return;
+
+    node->addUpdateCallback(this);
+    attached = true;
+}
+
+void Animator::detach()
+{
+    osg::ref_ptr<osg::Node> node;
+    if (!attached || !host.lock(node))
+        return;
+
+    // keep ourselves alive until we return; the host may hold the only
+    // other reference
+    osg::ref_ptr<Animator> self(this);
+    node->removeUpdateCallback(this);
+    attached = false;
+}
+
+void Animator::operator()(osg::Node *node, osg::NodeVisitor *nv)
+{
+    if (nv->getVisitorType() != osg::NodeVisitor::UPDATE_VISITOR)
+        return;
+
+    ProfileScope scope(Profiler::Animation);
+
+    auto frame_stamp = nv->getFrameStamp();
+    auto time = frame_stamp ? frame_stamp->getReferenceTime() : osg::Timer::instance()->time_s();
+
+    tweens.erase(std::remove_if(tweens.begin(), tweens.end(),
+                                [time](const TweenPtr &tween) { return !tween->update(time); }),
+                 tweens.end());
+
+    traverse(node, nv);
+
+    if (tweens.empty())
+        detach();
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include "OSG.h"
+
+// Tween -- a time-based animation of a single node.  Times are in
+// seconds, taken from the update traversal's frame stamp, so animations
+// run at the same speed regardless of frame rate.
+
+class Tween : public osg::Referenced
+{
+public:
+    Tween(osg::PositionAttitudeTransform *target_) : target(target_) {}
+
+    osg::PositionAttitudeTransform *get_target() const
+    {
+        return target.get();
+    }
+
+    // advance the animation to 'time'; returns false once it has finished
+    virtual bool update(double time) = 0;
+
+protected:
+    osg::observer_ptr<osg::PositionAttitudeTransform> target;
+    double start_time{-1.};     // set by the first update
+};
+
+using TweenPtr = osg::ref_ptr<Tween>;
+
+// PieceTween -- moves a piece to a new position over a fixed duration,
+// optionally lifting it along an arc (knights jumping, captured pieces
+// flying off to the holding cells)
+
+class PieceTween : public Tween
+{
+public:
+    PieceTween(osg::PositionAttitudeTransform *target_, const osg::Vec3d &destination_, double arc_height_ = 0.);
+
+    bool update(double time) override;
+
+protected:
+    osg::Vec3d origin;
+    osg::Vec3d destination;
+    double arc_height{0.};
+    double duration{0.};
+};
+
+// SpinTween -- rotates a node continuously about an axis
+
+class SpinTween : public Tween
+{
+public:
+    SpinTween(osg::PositionAttitudeTransform *target_, const osg::Vec3d &axis_, double radians_per_second_);
+
+    bool update(double time) override;
+
+protected:
+    osg::Vec3d axis;
+    double radians_per_second{0.};
+};
+
+// Animator -- drives the active tweens from the update traversal of its
+// host node.  It is attached to the host only while tweens are alive, so
+// a static scene costs nothing to update.
+
+class Animator : public osg::NodeCallback
+{
+public:
+    Animator(osg::Node *host_);
+
+    // start a tween, replacing any tween already animating the same node
+    void add(Tween *tween);
+
+    // stop whatever tween is animating the node
+    void remove(osg::Node *target);
+
+    bool is_animating() const
+    {
+        return !tweens.empty();
+    }
+
+    void operator()( osg::Node* node, osg::NodeVisitor* nv ) override;
+
+protected:
+    osg::observer_ptr<osg::Node> host;
+    std::vector<TweenPtr> tweens;
+    bool attached{false};
+
+    void attach();
+    void detach();
+};
+
+using AnimatorPtr = osg::ref_ptr<Animator>;
@@ -0,0 +1,724 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <random>
+#include <thread>
+
+#include "Benchmarks.h"
+#include "GameArchive.h"
+#include "MoveJournal.h"
+#include "NetPlay.h"
+#include "Handlers.h"
+#include "PgnPipeline.h"
+#include "PositionIndex.h"
+#include "Simul.h"
+
+#ifndef _WIN32
+#include <sys/resource.h> // for getrusage()
+#endif
+
+// the process's peak resident memory, in megabytes (0 if unknown)
+static double peak_memory_mb()
+{
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#ifdef __APPLE__
+        return usage.ru_maxrss / (1024. * 1024.); // bytes
+#else
+        return usage.ru_maxrss / 1024.; // kilobytes
+#endif
+    }
+#endif
+    return 0.;
+}
+
+int benchmark_picking(GamePtr game, int iterations)
+{
+    // an offscreen camera matching the default window; intersections
+    // don't need a graphics context
+
+    osg::ref_ptr<osg::Camera> camera(new osg::Camera);
+    camera->setViewMatrix(game->get_home_view());
+    camera->setProjectionMatrixAsPerspective(30., 800. / 600., 0.1, 10.);
+    camera->addChild(game->get_root_node().get());
+
+    osg::ref_ptr<SelectionHandler> handler(new SelectionHandler(game));
+
+    // a grid of mouse positions (normalized) covering the board
+
+    std::vector<std::pair<double, double>> positions;
+    for (auto i = 0; i < 16; ++i)
+    {
+        for (auto j = 0; j < 16; ++j)
+            positions.push_back(std::make_pair(-0.8 + i * 0.1, -0.8 + j * 0.1));
+    }
+
+    struct
+    {
+        PickHandlerInterface::PickMode mode;
+        const char *name;
+    } modes[] = {{PickHandlerInterface::PickMode::Polytope, "polytope"},
+                 {PickHandlerInterface::PickMode::Ray, "ray"},
+                 {PickHandlerInterface::PickMode::KdTreeRay, "ray+kdtree"}};
+
+    auto picks = positions.size() * static_cast<std::size_t>(iterations);
+    std::cout << "Mesh pick latency (" << picks << " picks per mode)" << std::endl;
+
+    auto timer = osg::Timer::instance();
+    for (const auto &mode : modes)
+    {
+        handler->set_pick_mode(mode.mode);
+
+        std::size_t hits = 0;
+        auto start = timer->tick();
+        for (auto i = 0; i < iterations; ++i)
+        {
+            for (const auto &position : positions)
+            {
+                osg::NodePath nodePath;
+                if (handler->intersect_meshes(position.first, position.second, camera.get(), nodePath))
+                    ++hits;
+            }
+        }
+        auto elapsed = timer->delta_u(start, timer->tick());
+
+        std::cout << std::setw(12) << mode.name << ": " << std::fixed << std::setprecision(2)
+                  << (elapsed / static_cast<double>(picks)) << " us/pick, "
+                  << (hits / static_cast<std::size_t>(iterations)) << " hits per sweep" << std::endl;
+    }
+
+    return 0;
+}
+
+int benchmark_fen(GamePtr game, int iterations)
+{
+    static const char *samples[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e6 0 2",
+        "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "4k3/8/8/8/8/8/8/4K3 b - - 99 150",
+    };
+
+    auto board = game->get_board();
+    auto count = sizeof(samples) / sizeof(samples[0]);
+
+    // every sample must come back out exactly as it went in
+
+    char buffer[Chessboard::fen_buffer_size] = {};
+    for (auto sample : samples)
+    {
+        auto length = std::strlen(sample);
+        if (!board->set_fen(sample, length) || board->to_fen(buffer, sizeof(buffer)) != length ||
+            std::memcmp(buffer, sample, length) != 0)
+        {
+            std::cout << "FEN round trip failed: '" << sample << "' came back as '" << buffer << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    // and none of these may be taken
+    static const char *rejects[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w  - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq  0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w QKkq - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBN1 w KQkq - 0 1",
+        "rnbqkbnr/pppppppp/44/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQ1BNR w kq - 0 1",
+        "Pnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e3 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP w KQkq - 0 1",
+    };
+
+    Chessboard::FenPosition position;
+    for (auto reject : rejects)
+    {
+        if (Chessboard::parse_fen(reject, std::strlen(reject), position))
+        {
+            std::cout << "FEN record wrongly accepted: '" << reject << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    auto positions = count * static_cast<std::size_t>(iterations);
+    std::cout << "FEN throughput (" << positions << " positions per pass)" << std::endl;
+
+    auto timer = osg::Timer::instance();
+
+    std::size_t parsed = 0;
+    auto start = timer->tick();
+    for (auto i = 0; i < iterations; ++i)
+    {
+        for (auto sample : samples)
+        {
+            if (Chessboard::parse_fen(sample, std::strlen(sample), position))
+                ++parsed;
+        }
+    }
+    auto parse_elapsed = timer->delta_s(start, timer->tick());
+
+    // and the whole of set_fen(): parsing, then setting up the board's
+    // pieces and telling its listeners
+    std::size_t set = 0;
+    start = timer->tick();
+    for (auto i = 0; i < iterations; ++i)
+    {
+        for (auto sample : samples)
+        {
+            if (board->set_fen(sample, std::strlen(sample)))
+                ++set;
+        }
+    }
+    auto set_elapsed = timer->delta_s(start, timer->tick());
+
+    // writing is timed on the board holding the last sample
+    std::size_t written = 0;
+    start = timer->tick();
+    for (std::size_t i = 0; i < positions; ++i)
+        written += board->to_fen(buffer, sizeof(buffer));
+    auto write_elapsed = timer->delta_s(start, timer->tick());
+
+    std::cout << std::setw(12) << "parse" << ": " << std::fixed << std::setprecision(2)
+              << (parsed / parse_elapsed / 1e6) << " M positions/s" << std::endl;
+    std::cout << std::setw(12) << "set_fen" << ": " << std::fixed << std::setprecision(2)
+              << (set / set_elapsed / 1e6) << " M positions/s" << std::endl;
+    std::cout << std::setw(12) << "write" << ": " << std::fixed << std::setprecision(2)
+              << (positions / write_elapsed / 1e6) << " M positions/s (" << written << " bytes)" << std::endl;
+
+    return 0;
+}
+
+// the leaves of the move tree below a position, trying each promotion
+
+static std::uint64_t perft(const Rules::Board &board, int depth)
+{
+    if (depth <= 0)
+        return 1;
+
+    std::uint64_t leaves = 0;
+    for (auto cell = 0; cell < 64; ++cell)
+    {
+        if ((board.cells[cell] >> 3) != board.to_move)
+            continue;
+
+        auto pawn = (board.cells[cell] & 7) == Rules::Pawn;
+        auto mask = Rules::legal_moves(board, cell / 8, cell % 8);
+        for (auto bits = mask.moves | mask.captures; bits; bits &= bits - 1)
+        {
+            auto target = lowest_bit(bits);
+            auto promotes = pawn && (target / 8 == 0 || target / 8 == 7);
+
+            for (auto promotion : {Rules::Queen, Rules::Rook, Rules::Bishop, Rules::Knight})
+            {
+                auto after = board;
+                Rules::make_move(after, cell / 8, cell % 8, target / 8, target % 8, promotion);
+                leaves += perft(after, depth - 1);
+                if (!promotes)
+                    break;
+            }
+        }
+    }
+
+    return leaves;
+}
+
+int benchmark_perft(GamePtr game, const std::string &fen, int depth)
+{
+    auto board = game->get_board();
+    if (!board->set_fen(fen))
+    {
+        std::cout << "Not a FEN record: '" << fen << "'" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Perft of " << fen << std::endl;
+
+    auto timer = osg::Timer::instance();
+    for (auto ply = 1; ply <= depth; ++ply)
+    {
+        auto start = timer->tick();
+        auto leaves = perft(board->get_rules_board(), ply);
+        auto elapsed = timer->delta_s(start, timer->tick());
+
+        std::cout << std::setw(8) << ply << ": " << std::setw(12) << leaves << std::fixed << std::setprecision(2)
+                  << std::setw(10) << elapsed << " s" << std::setw(10)
+                  << (elapsed > 0. ? leaves / elapsed / 1e6 : 0.) << " M positions/s" << std::endl;
+    }
+
+    return 0;
+}
+
+int benchmark_boards(LodBuilderPtr lod_builder, int max_boards, int frames)
+{
+    const auto width = 800, height = 600;
+    const auto warm_up = 10;
+
+    std::cout << "Frame time by board count (" << frames << " frames each)" << std::endl;
+    std::cout << std::setw(8) << "boards" << std::setw(12) << "ms/frame" << std::setw(12) << "worst ms"
+              << std::setw(12) << "peak MB" << std::endl;
+
+    auto timer = osg::Timer::instance();
+    for (auto boards = 1; boards <= max_boards; boards *= 2)
+    {
+        // a window without vsync, so frame times aren't rounded up to the
+        // display's refresh
+
+        osg::ref_ptr<osg::GraphicsContext::Traits> traits(new osg::GraphicsContext::Traits);
+        traits->readDISPLAY();
+        traits->setUndefinedScreenDetailsToDefaultScreen();
+        traits->x = 100;
+        traits->y = 100;
+        traits->width = width;
+        traits->height = height;
+        traits->windowDecoration = true;
+        traits->doubleBuffer = true;
+        traits->vsync = false;
+
+        osg::ref_ptr<osg::GraphicsContext> gc(osg::GraphicsContext::createGraphicsContext(traits.get()));
+        if (!gc.valid())
+        {
+            osg::notify(osg::FATAL) << "Failed to create a graphics context." << std::endl;
+            return 1;
+        }
+
+        SimulPtr simul(new Simul(boards, lod_builder));
+
+        // single threaded, so that frame() returns only once the frame is drawn
+        osgViewer::Viewer viewer;
+        viewer.setThreadingModel(osgViewer::ViewerBase::SingleThreaded);
+        viewer.setSceneData(simul->get_root_node().get());
+
+        auto camera = viewer.getCamera();
+        camera->setGraphicsContext(gc.get());
+        camera->setViewport(0, 0, width, height);
+        camera->setProjectionMatrixAsPerspective(30., static_cast<double>(width) / height, 0.1, 100.);
+        camera->setViewMatrix(simul->get_home_view());
+        camera->setClearColor(osg::Vec4(1., 1., 1., 1.));
+
+        viewer.realize();
+
+        for (auto i = 0; i < warm_up; ++i)
+            viewer.frame();
+
+        auto worst = 0.;
+        auto start = timer->tick();
+        for (auto i = 0; i < frames; ++i)
+        {
+            auto frame_start = timer->tick();
+            viewer.frame();
+            worst = std::max(worst, timer->delta_m(frame_start, timer->tick()));
+        }
+        auto elapsed = timer->delta_m(start, timer->tick());
+
+        std::cout << std::setw(8) << boards << std::fixed << std::setprecision(2) << std::setw(12)
+                  << (elapsed / frames) << std::setw(12) << worst << std::setw(12) << peak_memory_mb() << std::endl;
+    }
+
+    return 0;
+}
+
+static void print_pgn_report(const char *name, const PgnPipeline::Report &report)
+{
+    std::cout << std::setw(12) << name << ": " << report.games << " games, " << report.plies << " plies, "
+              << report.bad_games << " with errors in " << std::fixed << std::setprecision(2) << report.seconds
+              << " s (" << (report.games / report.seconds) << " games/s, " << (report.plies / report.seconds)
+              << " plies/s, " << (report.bytes / (1024. * 1024.) / report.seconds) << " MB/s)" << std::endl;
+}
+
+int benchmark_pgn(const std::string &path, unsigned int workers, bool ordered)
+{
+    auto count = [](PgnPipeline::Report &report, const PgnGame &game) {
+        ++report.games;
+        report.plies += game.get_moves().size();
+        if (game.get_error())
+        {
+            if (!report.bad_games++)
+                std::cout << "First bad game at offset " << game.get_offset() << ": " << game.get_error()
+                          << " at ply " << game.get_error_ply() << std::endl;
+        }
+    };
+
+    // one thread, straight through the reader
+
+    PgnReader reader;
+    if (!reader.open(path))
+        return 1;
+
+    PgnPipeline::Report serial;
+
+    auto timer = osg::Timer::instance();
+    auto start = timer->tick();
+    reader.read([&](const PgnGame &game) {
+        count(serial, game);
+        return true;
+    });
+    serial.seconds = timer->delta_s(start, timer->tick());
+    serial.bytes = reader.get_bytes_read();
+    reader.close();
+
+    print_pgn_report("1 thread", serial);
+
+    // then across the workers
+
+    PgnPipeline pipeline(workers, ordered);
+    PgnPipeline::Report parallel;
+    if (!pipeline.run(path, [](const PgnGame &) { return true; }, parallel))
+        return 1;
+
+    std::stringstream name;
+    name << pipeline.get_workers() << " workers";
+    print_pgn_report(name.str().c_str(), parallel);
+
+    std::cout << "Speedup " << std::fixed << std::setprecision(2) << (serial.seconds / parallel.seconds)
+              << "x, peak memory " << peak_memory_mb() << " MB" << std::endl;
+
+    return (parallel.games == serial.games && parallel.bad_games == serial.bad_games) ? 0 : 1;
+}
+
+int benchmark_archive(const std::string &path, int count)
+{
+    GameArchive archive;
+    if (!archive.open(path) || !archive.size())
+        return 1;
+
+    Chessboard board(Chessboard::Use::Position);
+    PgnGame game;
+
+    // a fixed pseudo-random order, so runs compare
+    std::uint64_t state = 88172645463325252ull;
+    std::size_t plies = 0, failures = 0;
+
+    auto timer = osg::Timer::instance();
+    auto start = timer->tick();
+    for (auto i = 0; i < count; ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        if (!archive.read(state % archive.size(), game) || !game.replay(board))
+        {
+            ++failures;
+            continue;
+        }
+        plies += game.get_moves().size();
+    }
+    auto elapsed = timer->delta_s(start, timer->tick());
+
+    std::cout << count << " random games of " << archive.size() << " read and replayed (" << plies << " plies, "
+              << failures << " failures) in " << std::fixed << std::setprecision(2) << elapsed << " s: "
+              << (count / elapsed) << " games/s" << std::endl;
+
+    return failures ? 1 : 0;
+}
+
+int benchmark_positions(const std::string &archive_file, const std::string &index_file, int queries)
+{
+    GameArchive archive;
+    PositionIndex index;
+    if (!archive.open(archive_file) || !index.open(index_file) || !archive.size())
+        return 1;
+
+    Chessboard board(Chessboard::Use::Position);
+    PgnGame game;
+    std::vector<std::uint32_t> games;
+
+    std::uint64_t state = 88172645463325252ull;
+    auto random = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+
+    // every query's own game should be among those found
+    std::size_t misses = 0, matches = 0;
+    double total = 0., worst = 0.;
+
+    auto timer = osg::Timer::instance();
+    for (auto i = 0; i < queries; ++i)
+    {
+        auto number = random() % archive.size();
+        if (!archive.read(number, game))
+            return 1;
+        if (!game.replay(board, random() % (game.get_moves().size() + 1)))
+            continue;
+
+        auto start = timer->tick();
+        matches += index.find(board, games);
+        auto elapsed = timer->delta_m(start, timer->tick());
+
+        total += elapsed;
+        worst = std::max(worst, elapsed);
+
+        if (std::find(games.begin(), games.end(), static_cast<std::uint32_t>(number)) == games.end())
+            ++misses;
+    }
+
+    std::cout << queries << " queries over " << index.size() << " entries: " << std::fixed << std::setprecision(4)
+              << (total / queries) << " ms mean, " << worst << " ms worst; " << matches << " games found, "
+              << misses << " misses" << std::endl;
+
+    return misses ? 1 : 0;
+}
+
+int benchmark_history(const std::string &archive_file, int jumps, unsigned int interval)
+{
+    GameArchive archive;
+    if (!archive.open(archive_file) || !archive.size())
+        return 1;
+
+    // the longest of the first few thousand games
+    PgnGame game, longest;
+    for (std::uint64_t n = 0; n < std::min<std::uint64_t>(archive.size(), 5000); ++n)
+    {
+        if (archive.read(n, game) && game.get_moves().size() > longest.get_moves().size())
+            std::swap(game, longest);
+    }
+
+    ChessboardPtr board(new Chessboard(Chessboard::Use::Position));
+    GameHistoryPtr history(new GameHistory(board, interval));
+    if (!longest.replay(*board) || history->size() != longest.get_moves().size() || !history->size())
+        return 1;
+
+    std::uint64_t state = 88172645463325252ull;
+    std::vector<std::size_t> targets(jumps);
+    for (auto &target : targets)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        target = state % (history->size() + 1);
+    }
+
+    // jumping through the history, against replaying from the start; each
+    // jump is checked against the replay
+    Chessboard replayed(Chessboard::Use::Position);
+    std::size_t mismatches = 0;
+    double seek_total = 0., seek_worst = 0., replay_total = 0., replay_worst = 0.;
+
+    auto timer = osg::Timer::instance();
+    for (auto target : targets)
+    {
+        auto start = timer->tick();
+        history->seek(target);
+        auto elapsed = timer->delta_u(start, timer->tick());
+        seek_total += elapsed;
+        seek_worst = std::max(seek_worst, elapsed);
+
+        start = timer->tick();
+        longest.replay(replayed, target);
+        elapsed = timer->delta_u(start, timer->tick());
+        replay_total += elapsed;
+        replay_worst = std::max(replay_worst, elapsed);
+
+        if (board->position_key() != replayed.position_key())
+            ++mismatches;
+    }
+
+    std::cout << jumps << " jumps within a game of " << history->size() << " plies, keeping every " << interval
+              << ": " << std::fixed << std::setprecision(1) << (seek_total / jumps) << " us mean, " << seek_worst
+              << " us worst; replaying from the start: " << (replay_total / jumps) << " us mean, " << replay_worst
+              << " us worst; " << mismatches << " mismatches" << std::endl;
+
+    return mismatches ? 1 : 0;
+}
+
+int benchmark_journal(const std::string &archive_file, const std::string &journal_file, int count)
+{
+    GameArchive archive;
+    if (!archive.open(archive_file) || !archive.size())
+        return 1;
+
+    std::vector<PgnGame> games(std::min<std::uint64_t>(archive.size(), count));
+    std::size_t plies = 0;
+    for (std::size_t n = 0; n < games.size(); ++n)
+    {
+        if (!archive.read(n, games[n]))
+            return 1;
+        plies += games[n].get_moves().size();
+    }
+
+    // the same games, played on a board without a journal and with one
+    ChessboardPtr board(new Chessboard(Chessboard::Use::Position));
+    auto timer = osg::Timer::instance();
+    auto play = [&]() {
+        auto start = timer->tick();
+        for (const auto &game : games)
+            game.replay(*board);
+        return timer->delta_u(start, timer->tick());
+    };
+
+    auto bare = play();
+
+    std::remove(journal_file.c_str());
+    MoveJournalPtr journal(new MoveJournal(board, journal_file));
+    journal->restore();
+    auto journaled = play();
+
+    auto start = timer->tick();
+    journal->flush();
+    auto flushing = timer->delta_m(start, timer->tick());
+    journal = nullptr;
+
+    // and the last of them should come back from the journal
+    ChessboardPtr restored(new Chessboard(Chessboard::Use::Position));
+    journal = new MoveJournal(restored, journal_file);
+    auto moves = journal->restore();
+    auto match = restored->position_key() == board->position_key() && moves == games.back().get_moves().size();
+
+    std::cout << games.size() << " games (" << plies << " plies) replayed: " << std::fixed << std::setprecision(3)
+              << (bare / plies) << " us/move bare, " << (journaled / plies) << " us/move journaled; " << flushing
+              << " ms to flush; the last game " << (match ? "restored" : "NOT restored") << " from " << moves
+              << " journaled moves" << std::endl;
+
+    return match ? 0 : 1;
+}
+
+// a NetPlay that can send any frame, to check the other board refuses what
+// it should
+class RawNetPlay : public NetPlay
+{
+public:
+    RawNetPlay(GamePtr game_) : NetPlay(game_) {}
+
+    using NetPlay::send_frame;
+};
+
+// one of the side to move's legal moves, at random; false if it has none
+static bool random_move(const Rules::Board &board, std::mt19937 &random, int &from, int &to)
+{
+    std::vector<std::pair<int, int>> moves;
+    for (auto cell = 0; cell < 64; ++cell)
+    {
+        if (!Rules::rank_at(board, cell / 8, cell % 8) || Rules::side_at(board, cell / 8, cell % 8) != board.to_move)
+            continue;
+
+        auto mask = Rules::legal_moves(board, cell / 8, cell % 8);
+        for (auto bits = mask.moves | mask.captures; bits; bits &= bits - 1)
+            moves.emplace_back(cell, lowest_bit(bits));
+    }
+
+    if (moves.empty())
+        return false;
+
+    auto pick = moves[std::uniform_int_distribution<std::size_t>(0, moves.size() - 1)(random)];
+    from = pick.first;
+    to = pick.second;
+    return true;
+}
+
+int benchmark_netplay(unsigned short port, int plies)
+{
+    GamePtr host_game(new Game), join_game(new Game);
+    osg::ref_ptr<RawNetPlay> host(new RawNetPlay(host_game));
+    NetPlayPtr join(new NetPlay(join_game));
+
+    // each acknowledged move is otherwise reported
+    auto notify_level = osg::getNotifyLevel();
+    osg::setNotifyLevel(osg::WARN);
+
+    auto timer = osg::Timer::instance();
+    auto key = [](GamePtr game) {
+        std::lock_guard<std::mutex> guard(game->get_lock());
+        return game->get_board()->position_key();
+    };
+
+    // wait (for a couple of seconds at most) for the boards to agree
+    auto agree = [&]() {
+        auto start = timer->tick();
+        while (!host->is_connected() || !join->is_connected() || key(host_game) != key(join_game))
+        {
+            if (timer->delta_s(start, timer->tick()) > 2.)
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    };
+
+    if (!host->host(port) || !join->join("127.0.0.1", port) || !agree())
+    {
+        osg::setNotifyLevel(notify_level);
+        std::cerr << "Can't connect two boards on port " << port << "." << std::endl;
+        return 1;
+    }
+
+    // a Black pawn moved on White's turn: the joining board should refuse
+    // it, or it will be a move ahead of the host for the rest of the game
+    host->send_frame('M', 6 * 8 + 4, 4 * 8 + 4, 0, 0);
+
+    // White moves on the host's board, and Black on the joining one
+    std::mt19937 random(1234);
+    std::vector<double> round_trips;
+    auto agreed = true;
+    for (auto ply = 0; ply < plies && agreed; ++ply)
+    {
+        auto mover = (ply % 2) ? join_game : host_game;
+        auto start = timer->tick();
+        {
+            std::lock_guard<std::mutex> guard(mover->get_lock());
+            auto board = mover->get_board();
+            int from, to;
+            if (!random_move(board->get_rules_board(), random, from, to))
+                break;
+
+            board->select((*board)(from / 8, from % 8));
+            board->move_selected_to(to / 8, to % 8);
+            board->clear_selection();
+        }
+
+        agreed = agree();
+        round_trips.push_back(timer->delta_u(start, timer->tick()));
+    }
+
+    join = nullptr;
+    host = nullptr;
+    osg::setNotifyLevel(notify_level);
+
+    if (!agreed || round_trips.empty())
+    {
+        std::cout << "The boards disagree after " << round_trips.size() << " plies"
+                  << (round_trips.size() <= 1 ? "; a move of the wrong colour was NOT refused" : "") << std::endl;
+        return 1;
+    }
+
+    std::sort(round_trips.begin(), round_trips.end());
+    std::cout << round_trips.size() << " plies played between two boards: " << std::fixed << std::setprecision(1)
+              << round_trips[round_trips.size() / 2] << " us median, " << round_trips.back()
+              << " us worst, from a move to the other board making it; a move of the wrong colour was refused"
+              << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include "Game.h"
+
+// Benchmarks -- command-line driven measurements of the hot paths, so
+// changes to them can be compared on the machines that matter.
+
+// time mesh intersections (the picking fallback) over a grid of mouse
+// positions, with and without the meshes' KD-trees
+int benchmark_picking(GamePtr game, int iterations);
+
+// time FEN parsing, setting the game's board and writing over a set of
+// sample positions, checking that each one survives the round trip through
+// the board, and that malformed records are refused
+int benchmark_fen(GamePtr game, int iterations);
+
+// count the positions reached by every sequence of legal moves from a FEN
+// record, to each depth up to the one given (a "perft"), and time them;
+// the counts can be checked against published ones for the same record
+int benchmark_perft(GamePtr game, const std::string &fen, int depth);
+
+// read every game in a PGN file, first on one thread and then through a
+// PgnPipeline, and report how many there were, how many had bad moves,
+// and how fast they went by
+int benchmark_pgn(const std::string &path, unsigned int workers, bool ordered);
+
+// read games from an archive (see GameArchive) in a random order, and
+// replay each one on a board
+int benchmark_archive(const std::string &path, int count);
+
+// replay random archived games to a random ply, and time finding the
+// games that reach each position in the archive's position index
+int benchmark_positions(const std::string &archive_file, const std::string &index_file, int queries);
+
+// record the longest of an archive's first games in a GameHistory, and
+// time jumps to random plies, against replaying the game up to each one
+int benchmark_history(const std::string &archive_file, int jumps, unsigned int interval);
+
+// replay archived games with and without a MoveJournal on the board, and
+// check the last of them comes back from the journal
+int benchmark_journal(const std::string &archive_file, const std::string &journal_file, int count);
+
+// connect two boards over TCP on a port and play a random game of up to
+// the given plies between them, timing each move until the other board has
+// made it; checks that a move of the wrong colour is refused on the way
+int benchmark_netplay(unsigned short port, int plies);
+
+// time frames drawing a wall of 1, 2, 4 ... max_boards boards in one
+// window (see Simul), and report the process's peak memory after each
+int benchmark_boards(LodBuilderPtr lod_builder, int max_boards, int frames);
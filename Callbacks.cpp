@@ -23,129 +23,15 @@
 //------------------------------------------------------------------------------
 
 #include "Callbacks.h"
+#include "Game.h"
 
- PositionPieceCallback::PositionPieceCallback(ChessboardPtr board_) : board(board_) {}
+UpdateSceneCallback::UpdateSceneCallback(Game *game_) : game(game_) {}
 
-void PositionPieceCallback::operator()(osg::Node *node, osg::NodeVisitor *nv)
+void UpdateSceneCallback::operator()(osg::Node *node, osg::NodeVisitor *nv)
 {
-    if (nv->getVisitorType() != osg::NodeVisitor::UPDATE_VISITOR)
-        return;
-
-    auto node_id = node->getName();
-    if (board->is_piece(node_id))
-    {
-        Chessboard::Cell &cell = board->find_piece(node_id);
-        Chessboard::Piece piece = cell.get_piece();
-
-        auto center = cell.get_center();
-
-        auto patt = dynamic_cast<osg::PositionAttitudeTransform *>(node);
-        if (patt != nullptr)
-        {
-            osg::Vec3d pos(center.x, center.y, 0.020);
-            osg::Vec3d current_position = patt->getPosition();
-
-            auto pos0_eq = compare_f<double>(current_position[0], pos[0]);
-            auto pos1_eq = compare_f<double>(current_position[1], pos[1]);
-
-            if (!pos0_eq || !pos1_eq)
-                patt->setPosition(pos);
-        }
-    }
-
-    traverse(node, nv);
-}
-
-EnableAttackMarkerCallback::EnableAttackMarkerCallback(ChessboardPtr board_) : board(board_) {}
-
-void EnableAttackMarkerCallback::operator()(osg::Node *node, osg::NodeVisitor *nv)
-{
-    if (nv->getVisitorType() != osg::NodeVisitor::UPDATE_VISITOR)
-        return;
-
-    auto node_id = node->getName();
-    if (node_id == "Switch.White.Attack.Marker")
-    {
-        osg::Switch *switch_node = dynamic_cast<osg::Switch *>(node);
-
-        if (board->local_side() == Chessboard::Black)
-        {
-            // turn off the White maker and remove its rotation
-            if (switch_node->getValue(0))
-                switch_node->setValue(0, false);
-        }
-        else
-        {
-            if (!switch_node->getValue(0))
-                switch_node->setValue(0, true);
-        }
-    }
-    else if (node_id == "Switch.Black.Attack.Marker")
-    {
-        osg::Switch *switch_node = dynamic_cast<osg::Switch *>(node);
-
-        if (board->local_side() == Chessboard::White)
-        {
-            // turn off the White maker and remove its rotation
-            if (switch_node->getValue(0))
-                switch_node->setValue(0, false);
-        }
-        else
-        {
-            if (!switch_node->getValue(0))
-                switch_node->setValue(0, true);
-        }
-    }
-
-    traverse(node, nv);
-}
-
-RotateAttackMarkerCallback::RotateAttackMarkerCallback() {}
-
-void RotateAttackMarkerCallback::operator()(osg::Node *node, osg::NodeVisitor *nv)
-{
-    if (nv->getVisitorType() != osg::NodeVisitor::UPDATE_VISITOR)
-        return;
-
-    auto node_id = node->getName();
-    if (node_id == "Rotate.White.Attack.Marker")
-    {
-        // rotate this marker
-
-        auto patt = dynamic_cast<osg::PositionAttitudeTransform *>(node);
-        auto att = patt->getAttitude();
-
-        double angle;
-        osg::Vec3d axis;
-        att.getRotate(angle, axis);
-
-        axis.set(0., 1., 0.);
-        angle += 0.01;
-        if (angle > (2 * M_PI))
-            angle = 0.;
-
-        osg::Quat new_att(angle, axis);
-        patt->setAttitude(new_att);
-    }
-    else if (node_id == "Rotate.Black.Attack.Marker")
-    {
-        // rotate this marker
-
-        auto patt = dynamic_cast<osg::PositionAttitudeTransform *>(node);
-        auto att = patt->getAttitude();
-
-        double angle;
-        osg::Vec3d axis;
-        att.getRotate(angle, axis);
-
-        axis.set(0., 1., 0.);
-        angle -= 0.01;
-        if (angle < 0.)
-            angle = (2 * M_PI);
-
-        osg::Quat new_att(angle, axis);
-        patt->setAttitude(new_att);
-    }
+    osg::ref_ptr<Game> owner;
+    if (nv->getVisitorType() == osg::NodeVisitor::UPDATE_VISITOR && game.lock(owner))
+        owner->update_scene();
 
     traverse(node, nv);
 }
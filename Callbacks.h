@@ -27,32 +27,18 @@
 #include "OSG.h"
 #include "Chessboard.h"
 
-class PositionPieceCallback : public osg::NodeCallback
-{
-public:
-    PositionPieceCallback(ChessboardPtr board);
-
-    void operator()( osg::Node* node, osg::NodeVisitor* nv ) override;
+class Game;
 
-protected:
-    ChessboardPtr board;
-};
+// UpdateSceneCallback -- brings a game's scene up to date with the board
+// state it last published (see Game::update_scene())
 
-class EnableAttackMarkerCallback : public osg::NodeCallback
+class UpdateSceneCallback : public osg::NodeCallback
 {
 public:
-    EnableAttackMarkerCallback(ChessboardPtr board_);
+    UpdateSceneCallback(Game* game_);
 
     void operator()( osg::Node* node, osg::NodeVisitor* nv ) override;
 
 protected:
-    ChessboardPtr board;
-};
-
-class RotateAttackMarkerCallback : public osg::NodeCallback
-{
-public:
-    RotateAttackMarkerCallback();
-
-    void operator()( osg::Node* node, osg::NodeVisitor* nv ) override;
+    osg::observer_ptr<Game> game;   // the game owns the scene, not the other way around
 };
@@ -0,0 +1,123 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "GameServer.h"
+#include "LoadGenerator.h"
+
+#include <time.h>
+
+// the headless server (and its load generator): nothing here draws, so
+// the program links the rules and none of OSG
+
+static const char *usage =
+    "usage: chess_server --serve <socket> [--boards <count>] [--threads <count>]\n"
+    "       chess_server --load <socket> [--connections <count>] [--games <count>] [--seconds <count>]\n";
+
+// the value following an option, if it's there
+
+static bool read_option(int argc, char **argv, const char *option, std::string &value)
+{
+    for (auto index = 1; index + 1 < argc; ++index)
+    {
+        if (!std::strcmp(argv[index], option))
+        {
+            value = argv[index + 1];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool read_option(int argc, char **argv, const char *option, double &value)
+{
+    std::string text;
+    if (!read_option(argc, argv, option, text))
+        return false;
+    value = std::atof(text.c_str());
+    return true;
+}
+
+// serve until interrupted, reporting the moves made each ten seconds
+
+static int serve(const std::string &path, std::size_t boards, int threads)
+{
+    // block the stopping signals here, so the workers inherit the mask and
+    // only the wait below sees them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    GameServer server(boards, threads);
+    if (!server.start(path))
+        return 1;
+
+    std::cout << "Serving " << boards << " boards at '" << path << "'" << std::endl;
+
+    const timespec report_interval = {10, 0};
+    auto moves = server.get_moves();
+    while (sigtimedwait(&signals, nullptr, &report_interval) < 0)
+    {
+        auto now = server.get_moves();
+        if (now != moves)
+            std::cout << server.get_connections() << " connections, " << server.get_games() << " games started, "
+                      << (now - moves) / 10 << " moves/s" << std::endl;
+        moves = now;
+    }
+
+    server.stop();
+    std::cout << server.get_games() << " games, " << server.get_moves() << " moves" << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string path;
+    if (read_option(argc, argv, "--serve", path))
+    {
+        double boards = 65536, threads = 0;
+        read_option(argc, argv, "--boards", boards);
+        read_option(argc, argv, "--threads", threads);
+        return serve(path, static_cast<std::size_t>(boards), static_cast<int>(threads));
+    }
+
+    if (read_option(argc, argv, "--load", path))
+    {
+        double connections = 8, games = 64, seconds = 10;
+        read_option(argc, argv, "--connections", connections);
+        read_option(argc, argv, "--games", games);
+        read_option(argc, argv, "--seconds", seconds);
+        return benchmark_server(path, static_cast<int>(connections), static_cast<int>(games), seconds);
+    }
+
+    std::cerr << usage;
+    return 1;
+}
@@ -29,9 +29,14 @@
 #include <iomanip>
 #include <tuple>
 #include <cassert>
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
 
 #include "Game.h"
 #include "Chessboard.h" // includes OSG.h
+#include "Profiler.h"
+#include "Visitors.h"
 
 #include <stdio.h>
 #include <sys/stat.h> // for stat()
@@ -40,9 +45,9 @@ static const std::string side_name[] = {"", "Black", "White"};
 static const std::string rank_name[] = {"", "Rook", "Knight", "Bishop", "King", "Queen", "Pawn"};
 
 static Chessboard::Piece::Rank white_major_type[] = {
-    Chessboard::Piece::Rank::Rook,  Chessboard::Piece::Rank::Knight, Chessboard::Piece::Rank::Bishop, Chessboard::Piece::Rank::King,
-    Chessboard::Piece::Rank::Queen, Chessboard::Piece::Rank::Bishop, Chessboard::Piece::Rank::Knight, Chessboard::Piece::Rank::Rook};
-static const char *white_major_name[] = {"WKR", "WKK", "WKB", "WKING", "WQUEEN", "WQB", "WQK", "WQR"};
+    Chessboard::Piece::Rank::Rook, Chessboard::Piece::Rank::Knight, Chessboard::Piece::Rank::Bishop, Chessboard::Piece::Rank::Queen,
+    Chessboard::Piece::Rank::King, Chessboard::Piece::Rank::Bishop, Chessboard::Piece::Rank::Knight, Chessboard::Piece::Rank::Rook};
+static const char *white_major_name[] = {"WQR", "WQK", "WQB", "WQUEEN", "WKING", "WKB", "WKK", "WKR"};
 static const char *white_minor_name[] = {"WP1", "WP2", "WP3", "WP4", "WP5", "WP6", "WP7", "WP8"};
 
 static Chessboard::Piece::Rank black_major_type[] = {
@@ -53,12 +58,36 @@ static const char *black_minor_name[] = {"BP1", "BP2", "BP3", "BP4", "BP5", "BP6
 
 static const char *board_id = "Chess.Board";
 
-MeshMap Chessboard::mesh_map;
+NodePtr Chessboard::piece_meshes[3][7];
 NodePtr Chessboard::board_mesh;
 NodePtr Chessboard::move_marker_mesh;
 NodePtr Chessboard::capture_marker_mesh;
 NodePtr Chessboard::attack_marker_mesh;
 
+// build KD-trees over the geometry of a freshly loaded mesh, so that ray
+// intersections (picking) don't need to test every triangle
+
+static void build_kdtrees(NodePtr &mesh)
+{
+    if (!mesh.valid())
+        return;
+
+    osg::ref_ptr<osg::KdTreeBuilder> builder(new osg::KdTreeBuilder);
+    mesh->accept(*builder);
+}
+
+// the exported meshes each carry their own copies of the same few
+// materials; fold them into shared StateSets so that every white piece
+// (for instance) is drawn without any state change between them
+
+static void share_state(NodePtr &mesh)
+{
+    static ShareStateSets sharer;
+
+    if (mesh.valid())
+        mesh->accept(sharer);
+}
+
 Chessboard::Piece::Piece() {}
 
 Chessboard::Piece::Piece(Rank rank_, Side side_, float facing_) : rank(rank_), side(side_), facing(facing_) {}
@@ -76,6 +105,7 @@ Chessboard::Piece &Chessboard::Piece::operator=(const Chessboard::Piece &source)
     row = source.row;
     col = source.col;
     name = source.name;
+    id = source.id;
 
     first_move = source.first_move;
     captured = source.captured;
@@ -84,68 +114,65 @@ Chessboard::Piece &Chessboard::Piece::operator=(const Chessboard::Piece &source)
     return *this;
 }
 
-void Chessboard::Piece::load_mesh(const std::string &id)
+// every piece of a given side and rank draws the same mesh, however many
+// boards there are
+
+static NodePtr load_piece_mesh(Chessboard::Side side, Chessboard::Piece::Rank rank)
 {
-    auto iter = mesh_map.find(id);
-    if (iter == mesh_map.end())
-    {
-        NodePtr mesh;
+    std::string content_path = "Objects";
+    std::string piece_path = content_path + "/" + side_name[side] + "/" + rank_name[static_cast<std::uint32_t>(rank)];
 
-        // load it
+    NodePtr mesh;
 
-        std::string content_path = "Objects";
-        std::string piece_path = content_path + "/" + side_name[side] + "/" + rank_name[static_cast<std::uint32_t>(rank)];
-        std::string piece_osg = piece_path + ".osg";
-        std::string piece_lwo = piece_path + ".lwo";
+    // load it
 
-        struct stat osg_st, lwo_st;
+    std::string piece_osg = piece_path + ".osg";
+    std::string piece_lwo = piece_path + ".lwo";
 
-        auto osg_exists = (stat(piece_osg.c_str(), &osg_st) == 0);
-        auto lwo_exists = (stat(piece_lwo.c_str(), &lwo_st) == 0);
+    struct stat osg_st, lwo_st;
 
-        if (osg_exists && lwo_exists)
-        {
-            // if LWO is newer, cause it to be re-loaded and re-saved
+    auto osg_exists = (stat(piece_osg.c_str(), &osg_st) == 0);
+    auto lwo_exists = (stat(piece_lwo.c_str(), &lwo_st) == 0);
 
-            if (lwo_st.st_mtime <= osg_st.st_mtime)
-                lwo_exists = false;
-        }
+    if (osg_exists && lwo_exists)
+    {
+        // if LWO is newer, cause it to be re-loaded and re-saved
 
-        if (lwo_exists)
-        {
-            // load in the LWO file
-            mesh = osgDB::readNodeFile(piece_lwo);
-            if (mesh.valid())
-            {
-                // save it as OSG for later loading
-                auto result = osgDB::writeNodeFile(*(mesh.get()), piece_osg.c_str());
-                if (!result)
-                    osg::notify(osg::FATAL) << "Failed in osgDB::writeNodeFile()." << std::endl;
-            }
-        }
-        else // only the OSG format exists
-            mesh = osgDB::readNodeFile(piece_osg);
+        if (lwo_st.st_mtime <= osg_st.st_mtime)
+            lwo_exists = false;
+    }
 
+    if (lwo_exists)
+    {
+        // load in the LWO file
+        mesh = osgDB::readNodeFile(piece_lwo);
         if (mesh.valid())
         {
-            mesh_map[id] = mesh;
-            iter = mesh_map.find(id);
+            // save it as OSG for later loading
+            auto result = osgDB::writeNodeFile(*(mesh.get()), piece_osg.c_str());
+            if (!result)
+                osg::notify(osg::FATAL) << "Failed in osgDB::writeNodeFile()." << std::endl;
         }
     }
+    else // only the OSG format exists
+        mesh = osgDB::readNodeFile(piece_osg);
 
-    if (iter != mesh_map.end())
-    {
-        iter->second->setName(id.c_str());
-        // std::string name = iter->second->getName();
-    }
+    build_kdtrees(mesh);
+    share_state(mesh);
+
+    return mesh;
 }
 
-NodePtr Chessboard::Piece::get_mesh()
+NodePtr Chessboard::Piece::get_mesh() const
 {
-    const auto iter = mesh_map.find(name);
-    if (iter == mesh_map.end())
-        return NodePtr();
-    return iter->second.get();
+    return piece_meshes[side][static_cast<std::uint32_t>(rank)];
+}
+
+std::string Chessboard::Piece::get_name() const
+{
+    if (name)
+        return name;
+    return side_name[side].substr(0, 1) + rank_name[static_cast<std::uint32_t>(rank)] + "=" + std::to_string(id);
 }
 
 void Chessboard::Piece::capture()
@@ -169,7 +196,7 @@ Bounds Chessboard::Cell::get_bounds()
     return Bounds(center.x - 0.025, center.y - 0.025, center.x + 0.025, center.y + 0.025);
 }
 
-Chessboard::Chessboard()
+Chessboard::Chessboard(Use use)
 {
     std::string content_path = "Objects";
 
@@ -192,13 +219,29 @@ Chessboard::Chessboard()
                         osg::notify(osg::FATAL) << "Failed in osgDB::writeNodeFile()." << std::endl;
                 }
             }
+
+            build_kdtrees(node);
+            share_state(node);
         }
     };
 
-    load_mesh(board_mesh, content_path, "Board");
-    load_mesh(move_marker_mesh, content_path, "MoveMarker");
-    load_mesh(capture_marker_mesh, content_path, "CaptureMarker");
-    load_mesh(attack_marker_mesh, content_path, "AttackMarker");
+    static std::once_flag meshes_loaded;
+    if (use == Use::Scene)
+    {
+        std::call_once(meshes_loaded, [&]() {
+            load_mesh(board_mesh, content_path, "Board");
+            load_mesh(move_marker_mesh, content_path, "MoveMarker");
+            load_mesh(capture_marker_mesh, content_path, "CaptureMarker");
+            load_mesh(attack_marker_mesh, content_path, "AttackMarker");
+
+            for (auto side : {Black, White})
+            {
+                for (auto rank : {Piece::Rank::Rook, Piece::Rank::Knight, Piece::Rank::Bishop, Piece::Rank::King,
+                                  Piece::Rank::Queen, Piece::Rank::Pawn})
+                    piece_meshes[side][static_cast<std::uint32_t>(rank)] = load_piece_mesh(side, rank);
+            }
+        });
+    }
 
     // map each board cell to a world position
 
@@ -229,6 +272,7 @@ Chessboard::Chessboard()
             white_p.y += 0.05;
         }
 
+        white_capture[index].type = Cell::Type::Holding;
         white_capture[index].center.x = white_p.x;
         white_p.x += 0.05;
         white_capture[index].center.y = white_p.y;
@@ -245,6 +289,7 @@ Chessboard::Chessboard()
             black_p.y -= 0.05;
         }
 
+        black_capture[index].type = Cell::Type::Holding;
         black_capture[index].center.x = black_p.x;
         black_p.x += 0.05;
         black_capture[index].center.y = black_p.y;
@@ -277,15 +322,17 @@ Chessboard::Chessboard()
             {
                 board[row][col].piece.set_rank(white_major_type[col]);
                 board[row][col].piece.set_name(white_major_name[col]);
+                board[row][col].piece.set_id(col);
             }
             else
             {
                 board[row][col].piece.set_rank(Piece::Rank::Pawn);
                 board[row][col].piece.set_name(white_minor_name[col]);
+                board[row][col].piece.set_id(8 + col);
             }
 
             board[row][col].piece.set_side(White);
-            board[row][col].piece.load_mesh(board[row][col].piece.get_name());
+            board[row][col].piece.place(row, col, false);
         }
     }
 
@@ -299,1406 +346,942 @@ Chessboard::Chessboard()
             {
                 board[row][col].piece.set_rank(Piece::Rank::Pawn);
                 board[row][col].piece.set_name(black_minor_name[col]);
+                board[row][col].piece.set_id(16 + col);
             }
             else
             {
                 board[row][col].piece.set_rank(black_major_type[col]);
                 board[row][col].piece.set_name(black_major_name[col]);
+                board[row][col].piece.set_id(24 + col);
             }
 
             board[row][col].piece.set_side(Black);
-            board[row][col].piece.load_mesh(board[row][col].piece.get_name());
+            board[row][col].piece.set_facing(0.f);
+            board[row][col].piece.place(row, col, false);
         }
     }
+
+    // empty the holding cells, and start over with White to move
+
+    for (auto index : Game::one_side)
+    {
+        white_capture[index].clear();
+        black_capture[index].clear();
+    }
+    white_capture_index = 0;
+    black_capture_index = 0;
+
+    Rules::start(rules);
+
+    clear_selection();
+
+    notify_board_reset();
 }
 
-NodePtr Chessboard::get_board_mesh()
+void Chessboard::add_listener(Listener *listener)
 {
-    if (!board_mesh.valid())
-        return NodePtr();
-    return board_mesh.get();
+    if (std::find(listeners.begin(), listeners.end(), listener) == listeners.end())
+        listeners.push_back(listener);
 }
 
-NodePtr Chessboard::get_move_marker_mesh()
+void Chessboard::remove_listener(Listener *listener)
 {
-    if (!move_marker_mesh.valid())
-        return NodePtr();
-    return move_marker_mesh.get();
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
 }
 
-NodePtr Chessboard::get_capture_marker_mesh()
+void Chessboard::hold_notifications()
 {
-    if (!capture_marker_mesh.valid())
-        return NodePtr();
-    return capture_marker_mesh.get();
+    ++notifications_held;
 }
 
-NodePtr Chessboard::get_attack_marker_mesh()
+void Chessboard::release_notifications()
 {
-    if (!attack_marker_mesh.valid())
-        return NodePtr();
-    return attack_marker_mesh.get();
+    if (!notifications_held || --notifications_held)
+        return;
+
+    auto reset = held_reset;
+    auto change = held_change;
+    held_reset = held_change = false;
+
+    if (reset)
+        notify_board_reset();
+    else if (change)
+        notify_position_changed();
 }
 
-bool Chessboard::is_piece(const std::string &node_id)
+void Chessboard::notify_piece_moved(const Piece &piece, const Cell &cell)
 {
-    MeshMapConstIter iter;
-    for (iter = mesh_map.begin(); iter != mesh_map.end(); ++iter)
+    if (notifications_held)
     {
-        auto mesh = &(*iter->second);
-        if (mesh->getName() == node_id)
-            return true;
+        held_change = true;
+        return;
     }
 
-    return false;
+    for (auto listener : listeners)
+        listener->piece_moved(piece, cell);
 }
 
-Chessboard::Cell &Chessboard::find_piece(const std::string &name)
+void Chessboard::notify_board_reset()
 {
-    for (auto row : Game::one_rank)
+    if (notifications_held)
     {
-        for (auto col : Game::one_rank)
-        {
-            if (!board[row][col].has_piece())
-                continue;
-            if (board[row][col].piece.get_name() == name)
-                return board[row][col];
-        }
+        held_reset = true;
+        return;
     }
 
-    // check the capture squares
+    for (auto listener : listeners)
+        listener->board_reset();
+}
 
-    for (auto i : Game::one_side)
+void Chessboard::notify_side_changed()
+{
+    if (notifications_held)
     {
-        if (!black_capture[i].has_piece())
-            continue;
-        if (black_capture[i].piece.get_name() == name)
-            return black_capture[i];
+        held_change = true;
+        return;
     }
 
-    for (auto i : Game::one_side)
+    for (auto listener : listeners)
+        listener->side_changed(local_side());
+}
+
+void Chessboard::notify_position_changed()
+{
+    if (notifications_held)
     {
-        if (!white_capture[i].has_piece())
-            continue;
-        if (white_capture[i].piece.get_name() == name)
-            return white_capture[i];
+        held_change = true;
+        return;
     }
 
-    throw "Invalid piece information provided!";
+    for (auto listener : listeners)
+        listener->position_changed();
 }
 
-bool Chessboard::select(Cell &cell)
+void Chessboard::notify_move_made(int from_row, int from_col, int to_row, int to_col, Piece::Rank promotion)
 {
-    if (!board[cell.row][cell.col].has_piece())
-        return false;
-
-    selected = Position(cell.row, cell.col);
+    if (notifications_held)
+        return;
 
-    return true;
+    for (auto listener : listeners)
+        listener->move_made(from_row, from_col, to_row, to_col, promotion);
 }
 
-bool Chessboard::select(Piece &piece)
+void Chessboard::get_state(State &state) const
 {
-    if (piece.is_captured())
-        return false;
+    for (auto row : Game::one_rank)
+    {
+        for (auto col : Game::one_rank)
+            state.board[row][col] = board[row][col].piece;
+    }
 
-    selected = piece.get_position();
+    for (auto index : Game::one_side)
+    {
+        state.white_capture[index] = white_capture[index].piece;
+        state.black_capture[index] = black_capture[index].piece;
+    }
 
-    return true;
+    state.white_capture_index = white_capture_index;
+    state.black_capture_index = black_capture_index;
+    state.to_move = local_side();
+    state.castling = rules.castling;
+    state.en_passant = rules.en_passant;
+    state.halfmove_clock = rules.halfmove_clock;
+    state.fullmove_number = rules.fullmove_number;
 }
 
-bool Chessboard::move_selected_to(int row, int col)
+void Chessboard::set_state(const State &state)
 {
-    int selected_row, selected_col;
-    std::tie(selected_row, selected_col) = selected;
-
-    if (!board[selected_row][selected_col].has_piece())
-        return false;
-
-    if (board[row][col].has_piece())
+    for (auto row : Game::one_rank)
     {
-        // it's an opposing piece; this is an attack.
-        // move the piece to my next available capture
-        // spot
-
-        if (this_side == White)
-            white_capture[white_capture_index++].piece = board[row][col].piece;
-        else
-            black_capture[black_capture_index++].piece = board[row][col].piece;
-
-        board[row][col].piece.clear();
+        for (auto col : Game::one_rank)
+            board[row][col].piece = state.board[row][col];
     }
 
-    board[row][col].piece = board[selected_row][selected_col].piece;
-    board[row][col].piece.move_to(row, col);
-    board[selected_row][selected_col].piece.clear();
+    for (auto index : Game::one_side)
+    {
+        white_capture[index].piece = state.white_capture[index];
+        black_capture[index].piece = state.black_capture[index];
+    }
 
-    if (this_side == White)
-        this_side = Black;
-    else
-        this_side = White;
+    white_capture_index = state.white_capture_index;
+    black_capture_index = state.black_capture_index;
+    rules.to_move = state.to_move;
+    rules.castling = state.castling;
+    rules.en_passant = static_cast<std::int8_t>(state.en_passant);
+    rules.halfmove_clock = static_cast<std::uint16_t>(state.halfmove_clock);
+    rules.fullmove_number = static_cast<std::uint16_t>(state.fullmove_number);
+    sync_rules();
 
-    return true;
-}
+    clear_selection();
 
-bool Chessboard::move_to(const Piece &/*piece*/, int /*row*/, int /*col*/)
-{
-    return false;
+    notify_position_changed();
 }
 
-// given a cell, piece or board position, calculate a list of
-// valid paths that the board piece at that location can take
+// pieces on the board need unique names (the scene finds them by name).
+// hand out the names used by the initial setup first, in file order; any
+// extras (e.g., promoted queens) are named after their ids when asked.
 
-ListStringList Chessboard::valid_paths(int row, int col)
+static const char *next_piece_name(Chessboard::Side side, Chessboard::Piece::Rank rank, int &used)
 {
-    if (board[row][col].type != Cell::Type::Board || board[row][col].piece.get_rank() == Piece::Rank::Empty)
-        return ListStringList();
+    auto major_type = (side == Chessboard::White) ? white_major_type : black_major_type;
+    auto major_name = (side == Chessboard::White) ? white_major_name : black_major_name;
+    auto minor_name = (side == Chessboard::White) ? white_minor_name : black_minor_name;
 
-    return calc_valid_paths(row, col);
-}
+    auto index = used++;
+    for (auto col : Game::one_rank)
+    {
+        if (rank == Chessboard::Piece::Rank::Pawn)
+        {
+            if (col == index)
+                return minor_name[col];
+        }
+        else if (major_type[col] == rank && !index--)
+            return major_name[col];
+    }
 
-ListStringList Chessboard::valid_paths(Cell &cell)
-{
-    int row, col;
-    std::tie(row, col) = cell.get_position();
+    return nullptr;
+}
 
-    if (board[row][col].type != Cell::Type::Board || board[row][col].piece.get_rank() == Piece::Rank::Empty)
-        return ListStringList();
+// FEN is read in a single pass over the text, with no allocation and no
+// streams, so that batch tools can get through millions of positions
 
-    return calc_valid_paths(row, col);
-}
+static const char fen_letters[] = " rnbkqp"; // indexed by Piece::Rank
 
-ListStringList Chessboard::valid_paths(Piece &piece)
+// a clock field: digits only, without a sign or leading zeros
+static bool parse_count(const char *&p, const char *end, int &value, int min_value)
 {
-    int row, col;
-    std::tie(row, col) = piece.get_position();
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+    if (*p == '0' && p + 1 != end && p[1] >= '0' && p[1] <= '9')
+        return false;
 
-    if (board[row][col].type != Cell::Type::Board || board[row][col].piece.get_rank() == Piece::Rank::Empty)
-        return ListStringList();
+    value = 0;
+    for (auto digits = 0; p != end && *p >= '0' && *p <= '9'; ++p)
+    {
+        if (++digits > 6)
+            return false;
+        value = value * 10 + (*p - '0');
+    }
 
-    return calc_valid_paths(row, col);
+    return value >= min_value;
 }
 
-ListStringList Chessboard::calc_valid_paths(int row, int col)
+static char *write_count(char *p, int value)
 {
-    auto rank = board[row][col].piece.get_rank();
-
-    switch (rank)
+    char digits[12];
+    auto count = 0;
+    do
     {
-        case Piece::Rank::Rook:
-            return calc_rook_moves(row, col);
-        case Piece::Rank::Knight:
-            return calc_knight_moves(row, col);
-        case Piece::Rank::Bishop:
-            return calc_bishop_moves(row, col);
-        case Piece::Rank::King:
-            return calc_king_moves(row, col);
-        case Piece::Rank::Queen:
-            return calc_queen_moves(row, col);
-        case Piece::Rank::Pawn:
-            return calc_pawn_moves(row, col);
-        case Piece::Rank::Empty:
-            break;
-    }
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
 
-    return ListStringList();
+    while (count)
+        *p++ = digits[--count];
+    return p;
 }
 
-ListStringList Chessboard::calc_pawn_moves(int row, int col)
+bool Chessboard::parse_fen(const char *fen, std::size_t length, FenPosition &position)
 {
-    // for pawns. white moves in increasing rows (1->8), while
-    // black moves in decreasing (8->1).  also, the first move
-    // may be two (unblocked) squares instead of one.
-
-    auto piece = board[row][col].piece;
-    auto side = piece.get_side();
+    if (!fen)
+        return false;
 
-    ListStringList paths;
+    auto p = fen;
+    auto end = fen + length;
 
-    if (side == White)
+    for (auto r : Game::one_rank)
     {
-        // check forward progress
-        auto first_square_clear = false;
-        if (row < 7 && board[row + 1][col].piece.get_rank() == Piece::Rank::Empty)
-        {
-            first_square_clear = true;
-
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << (row + 1) << "." << col;
-            std::string square_name = square_name_stream.str();
-
-            StringList target_squares;
-            target_squares.push_back(square_name);
-            paths.push_back(target_squares);
-        }
-
-        if (first_square_clear && !piece.has_moved() && board[row + 2][col].piece.get_rank() == Piece::Rank::Empty)
+        for (auto c : Game::one_rank)
         {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << (row + 2) << "." << col;
-            std::string square_name = square_name_stream.str();
-
-            StringList target_squares;
-            target_squares.push_back(square_name);
-            paths.push_back(target_squares);
+            position.ranks[r][c] = Piece::Rank::Empty;
+            position.sides[r][c] = White;
         }
+    }
 
-        // check for attack possibilities to the right
-        if (col > 0 && row < 7 && board[row + 1][col - 1].piece.get_rank() != Piece::Rank::Empty &&
-            board[row + 1][col - 1].piece.get_side() == Black)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Attack." << (row + 1) << "." << (col - 1);
-            std::string square_name = square_name_stream.str();
-
-            StringList target_squares;
-            target_squares.push_back(square_name);
-            paths.push_back(target_squares);
-        }
+    // 1: piece placement, from rank 8 down to rank 1
 
-        // check for attack possibilities to the left
-        if (col < 7 && row < 7 && board[row + 1][col + 1].piece.get_rank() != Piece::Rank::Empty &&
-            board[row + 1][col + 1].piece.get_side() == Black)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Attack." << (row + 1) << "." << (col + 1);
-            std::string square_name = square_name_stream.str();
-
-            StringList target_squares;
-            target_squares.push_back(square_name);
-            paths.push_back(target_squares);
-        }
-    }
-    else
+    int kings[3] = {0, 0, 0};
+    auto row = 7, col = 0;
+    auto after_digit = false;
+    for (; p != end && *p != ' '; ++p)
     {
-        // check forward progress
-        if (row > 0 && board[row - 1][col].piece.get_rank() == Piece::Rank::Empty)
+        auto ch = *p;
+        if (ch == '/')
         {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << (row - 1) << "." << col;
-            std::string square_name = square_name_stream.str();
-
-            StringList target_squares;
-            target_squares.push_back(square_name);
-            paths.push_back(target_squares);
+            if (col != 8 || row == 0)
+                return false;
+            --row;
+            col = 0;
+            after_digit = false;
+            continue;
         }
 
-        if (!piece.has_moved() && board[row - 2][col].piece.get_rank() == Piece::Rank::Empty)
+        if (ch >= '1' && ch <= '8')
         {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << (row - 2) << "." << col;
-            std::string square_name = square_name_stream.str();
-
-            StringList target_squares;
-            target_squares.push_back(square_name);
-            paths.push_back(target_squares);
+            // "44" instead of "8" isn't FEN
+            if (after_digit)
+                return false;
+            col += ch - '0';
+            if (col > 8)
+                return false;
+            after_digit = true;
+            continue;
         }
 
-        // check for attack possibilities to the right
-        if (col < 7 && row > 0 && board[row - 1][col + 1].piece.get_rank() != Piece::Rank::Empty &&
-            board[row - 1][col + 1].piece.get_side() == White)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Attack." << (row - 1) << "." << (col + 1);
-            std::string square_name = square_name_stream.str();
-
-            StringList target_squares;
-            target_squares.push_back(square_name);
-            paths.push_back(target_squares);
-        }
+        after_digit = false;
+        if (col > 7)
+            return false;
 
-        // check for attack possibilities to the left
-        if (col > 0 && row > 0 && board[row - 1][col - 1].piece.get_rank() != Piece::Rank::Empty &&
-            board[row - 1][col - 1].piece.get_side() == White)
+        Piece::Rank rank;
+        switch (ch)
         {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Attack." << (row - 1) << "." << (col - 1);
-            std::string square_name = square_name_stream.str();
-
-            StringList target_squares;
-            target_squares.push_back(square_name);
-            paths.push_back(target_squares);
+            case 'r': case 'R': rank = Piece::Rank::Rook; break;
+            case 'n': case 'N': rank = Piece::Rank::Knight; break;
+            case 'b': case 'B': rank = Piece::Rank::Bishop; break;
+            case 'q': case 'Q': rank = Piece::Rank::Queen; break;
+            case 'k': case 'K': rank = Piece::Rank::King; break;
+            case 'p': case 'P': rank = Piece::Rank::Pawn; break;
+            default: return false;
         }
+
+        auto side = (ch >= 'a') ? Black : White;
+
+        if (rank == Piece::Rank::Pawn && (row == 0 || row == 7))
+            return false;
+        if (rank == Piece::Rank::King)
+            ++kings[side];
+
+        position.ranks[row][col] = rank;
+        position.sides[row][col] = side;
+        ++col;
     }
 
-    return paths;
-}
+    if (row != 0 || col != 8 || kings[White] != 1 || kings[Black] != 1)
+        return false;
 
-ListStringList Chessboard::calc_knight_moves(int row, int col)
-{
-    // knight moves are about as easy as pawns.  at any given time,
-    // a knight can move to one of eight targets, leaping over any
-    // other pieces in its way.
+    auto has = [&position](int r, int c, Piece::Rank rank, Side side) {
+        return position.ranks[r][c] == rank && position.sides[r][c] == side;
+    };
 
-    auto piece = board[row][col].piece;
-    Piece::Rank target_rank;
+    // 2: side to move
 
-    auto side = piece.get_side();
-    Side opponent, target_side;
-    if (side == White)
-        opponent = Black;
-    else
-        opponent = White;
+    if (p == end || *p++ != ' ' || p == end)
+        return false;
 
-    ListStringList paths;
+    if (*p == 'w')
+        position.to_move = White;
+    else if (*p == 'b')
+        position.to_move = Black;
+    else
+        return false;
+    ++p;
 
-    // check forward...
+    // 3: castling rights, in "KQkq" order, each backed by an unmoved king
+    // and rook
 
-    // up one...
+    if (p == end || *p++ != ' ' || p == end)
+        return false;
 
-    if (row < 7)
+    position.castling = 0;
+    if (*p == ' ')
+        return false;
+    if (*p == '-')
+        ++p;
+    else
     {
-        // ...over two
+        static const char order[] = "KQkq";
+        static const std::uint8_t rights[] = {WhiteKingside, WhiteQueenside, BlackKingside, BlackQueenside};
 
-        if (col < 6)
+        auto next = 0;
+        for (; p != end && *p != ' '; ++p)
         {
-            target_rank = board[row + 1][col + 2].piece.get_rank();
-            target_side = board[row + 1][col + 2].piece.get_side();
-
-            if (target_rank == Piece::Rank::Empty || target_side == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker."
-                                   << ((target_rank == Piece::Rank::Empty || target_side != opponent) ? "Move" : "Attack")
-                                   << "." << (row + 1) << "." << (col + 2);
-                std::string square_name = square_name_stream.str();
-
-                StringList target_squares;
-                target_squares.push_back(square_name);
-                paths.push_back(target_squares);
-            }
+            // an unknown, repeated or out-of-order letter runs off the end
+            while (next < 4 && order[next] != *p)
+                ++next;
+            if (next == 4)
+                return false;
+            position.castling |= rights[next++];
         }
+    }
 
-        if (col > 1)
-        {
-            target_rank = board[row + 1][col - 2].piece.get_rank();
-            target_side = board[row + 1][col - 2].piece.get_side();
+    if ((position.castling & (WhiteKingside | WhiteQueenside)) && !has(0, 4, Piece::Rank::King, White))
+        return false;
+    if ((position.castling & WhiteKingside) && !has(0, 7, Piece::Rank::Rook, White))
+        return false;
+    if ((position.castling & WhiteQueenside) && !has(0, 0, Piece::Rank::Rook, White))
+        return false;
+    if ((position.castling & (BlackKingside | BlackQueenside)) && !has(7, 4, Piece::Rank::King, Black))
+        return false;
+    if ((position.castling & BlackKingside) && !has(7, 7, Piece::Rank::Rook, Black))
+        return false;
+    if ((position.castling & BlackQueenside) && !has(7, 0, Piece::Rank::Rook, Black))
+        return false;
 
-            if (target_rank == Piece::Rank::Empty || target_side == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker."
-                                   << ((target_rank == Piece::Rank::Empty || target_side != opponent) ? "Move" : "Attack")
-                                   << "." << (row + 1) << "." << (col - 2);
-                std::string square_name = square_name_stream.str();
-
-                StringList target_squares;
-                target_squares.push_back(square_name);
-                paths.push_back(target_squares);
-            }
-        }
-    }
+    // 4: the cell a pawn just passed over with a double step
 
-    // up two...
+    if (p == end || *p++ != ' ' || p == end)
+        return false;
 
-    if (row < 6)
+    position.en_passant = -1;
+    if (*p == '-')
+        ++p;
+    else
     {
-        // ...over one
+        if (end - p < 2 || p[0] < 'a' || p[0] > 'h')
+            return false;
 
-        if (col < 7)
-        {
-            target_rank = board[row + 2][col + 1].piece.get_rank();
-            target_side = board[row + 2][col + 1].piece.get_side();
+        auto ep_col = p[0] - 'a';
+        auto ep_row = p[1] - '1';
 
-            if (target_rank == Piece::Rank::Empty || target_side == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker."
-                                   << ((target_rank == Piece::Rank::Empty || target_side != opponent) ? "Move" : "Attack")
-                                   << "." << (row + 2) << "." << (col + 1);
-                std::string square_name = square_name_stream.str();
-
-                StringList target_squares;
-                target_squares.push_back(square_name);
-                paths.push_back(target_squares);
-            }
-        }
+        // the pawn that moved belongs to the side not on move
+        auto white_to_move = (position.to_move == White);
+        auto mover = white_to_move ? Black : White;
+        auto from_row = white_to_move ? 6 : 1;
+        auto pawn_row = white_to_move ? 4 : 3;
 
-        if (col > 0)
-        {
-            target_rank = board[row + 2][col - 1].piece.get_rank();
-            target_side = board[row + 2][col - 1].piece.get_side();
+        if (ep_row != (white_to_move ? 5 : 2) || !has(pawn_row, ep_col, Piece::Rank::Pawn, mover) ||
+            position.ranks[ep_row][ep_col] != Piece::Rank::Empty || position.ranks[from_row][ep_col] != Piece::Rank::Empty)
+            return false;
 
-            if (target_rank == Piece::Rank::Empty || target_side == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker."
-                                   << ((target_rank == Piece::Rank::Empty || target_side != opponent) ? "Move" : "Attack")
-                                   << "." << (row + 2) << "." << (col - 1);
-                std::string square_name = square_name_stream.str();
-
-                StringList target_squares;
-                target_squares.push_back(square_name);
-                paths.push_back(target_squares);
-            }
-        }
+        position.en_passant = ep_row * 8 + ep_col;
+        p += 2;
     }
 
-    // check backward...
+    // 5 and 6: the clocks, which EPD-style records leave off
 
-    // back one...
-
-    if (row > 0)
-    {
-        // ...over two
+    position.halfmove_clock = 0;
+    position.fullmove_number = 1;
+    if (p == end)
+        return true;
 
-        if (col < 6)
-        {
-            target_rank = board[row - 1][col + 2].piece.get_rank();
-            target_side = board[row - 1][col + 2].piece.get_side();
+    if (*p++ != ' ' || !parse_count(p, end, position.halfmove_clock, 0))
+        return false;
+    if (p == end || *p++ != ' ' || !parse_count(p, end, position.fullmove_number, 1))
+        return false;
 
-            if (target_rank == Piece::Rank::Empty || target_side == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker."
-                                   << ((target_rank == Piece::Rank::Empty || target_side != opponent) ? "Move" : "Attack")
-                                   << "." << (row - 1) << "." << (col + 2);
-                std::string square_name = square_name_stream.str();
-
-                StringList target_squares;
-                target_squares.push_back(square_name);
-                paths.push_back(target_squares);
-            }
-        }
+    return p == end;
+}
 
-        if (col > 1)
+void Chessboard::set_position(const FenPosition &position)
+{
+    int used[3][7] = {};
+    auto next_id = 0;
+    for (auto r : Game::one_rank)
+    {
+        for (auto c : Game::one_rank)
         {
-            target_rank = board[row - 1][col - 2].piece.get_rank();
-            target_side = board[row - 1][col - 2].piece.get_side();
+            Piece &piece = board[r][c].piece;
+            piece = Piece();
 
-            if (target_rank == Piece::Rank::Empty || target_side == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker."
-                                   << ((target_rank == Piece::Rank::Empty || target_side != opponent) ? "Move" : "Attack")
-                                   << "." << (row - 1) << "." << (col - 2);
-                std::string square_name = square_name_stream.str();
-
-                StringList target_squares;
-                target_squares.push_back(square_name);
-                paths.push_back(target_squares);
-            }
+            auto piece_rank = position.ranks[r][c];
+            if (piece_rank == Piece::Rank::Empty)
+                continue;
+
+            auto piece_side = position.sides[r][c];
+            auto home_row = (piece_side == White) ? 0 : 7;
+            auto kingside = (piece_side == White) ? WhiteKingside : BlackKingside;
+            auto queenside = (piece_side == White) ? WhiteQueenside : BlackQueenside;
+
+            // pawns off their starting rank must have moved; kings and
+            // rooks have if they've lost the right to castle
+            auto moved = false;
+            if (piece_rank == Piece::Rank::Pawn)
+                moved = (r != ((piece_side == White) ? 1 : 6));
+            else if (piece_rank == Piece::Rank::King)
+                moved = !(position.castling & (kingside | queenside));
+            else if (piece_rank == Piece::Rank::Rook)
+                moved = !((r == home_row && c == 7 && (position.castling & kingside)) ||
+                          (r == home_row && c == 0 && (position.castling & queenside)));
+
+            piece.set_rank(piece_rank);
+            piece.set_side(piece_side);
+            piece.set_name(next_piece_name(piece_side, piece_rank, used[piece_side][static_cast<std::uint32_t>(piece_rank)]));
+            piece.set_id(next_id++);
+            piece.set_facing((piece_side == White) ? 1.0f : 0.f);
+            piece.place(r, c, moved);
         }
     }
 
-    // back two...
-
-    if (row > 1)
+    for (auto index : Game::one_side)
     {
-        // ...over one
-
-        if (col < 7)
-        {
-            target_rank = board[row - 2][col + 1].piece.get_rank();
-            target_side = board[row - 2][col + 1].piece.get_side();
-
-            if (target_rank == Piece::Rank::Empty || target_side == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker."
-                                   << ((target_rank == Piece::Rank::Empty || target_side != opponent) ? "Move" : "Attack")
-                                   << "." << (row - 2) << "." << (col + 1);
-                std::string square_name = square_name_stream.str();
-
-                StringList target_squares;
-                target_squares.push_back(square_name);
-                paths.push_back(target_squares);
-            }
-        }
+        white_capture[index].clear();
+        black_capture[index].clear();
+    }
+    white_capture_index = 0;
+    black_capture_index = 0;
 
-        if (col > 0)
-        {
-            target_rank = board[row - 2][col - 1].piece.get_rank();
-            target_side = board[row - 2][col - 1].piece.get_side();
+    rules.to_move = position.to_move;
+    rules.castling = position.castling;
+    rules.en_passant = static_cast<std::int8_t>(position.en_passant);
+    rules.halfmove_clock = static_cast<std::uint16_t>(position.halfmove_clock);
+    rules.fullmove_number = static_cast<std::uint16_t>(position.fullmove_number);
+    sync_rules();
 
-            if (target_rank == Piece::Rank::Empty || target_side == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker."
-                                   << ((target_rank == Piece::Rank::Empty || target_side != opponent) ? "Move" : "Attack")
-                                   << "." << (row - 2) << "." << (col - 1);
-                std::string square_name = square_name_stream.str();
-
-                StringList target_squares;
-                target_squares.push_back(square_name);
-                paths.push_back(target_squares);
-            }
-        }
-    }
+    clear_selection();
 
-    return paths;
+    notify_board_reset();
 }
 
-ListStringList Chessboard::calc_rook_moves(int row, int col)
+bool Chessboard::set_fen(const char *fen, std::size_t length)
 {
-    // rooks move in row-column order, any number of moves until
-    // they meet opposition or the end of the board.
-    // castling is also verified, which requires the king and the
-    // king's rook to not yet have moved.
-
-    auto piece = board[row][col].piece;
-
-    auto side = piece.get_side();
-    Side opponent;
-    if (side == White)
-        opponent = Black;
-    else
-        opponent = White;
-
-    ListStringList paths;
+    FenPosition position;
+    if (!parse_fen(fen, length, position))
+        return false;
 
-    auto i = row + 1;
+    set_position(position);
+    return true;
+}
 
-    StringList target_squares;
+std::size_t Chessboard::to_fen(char *buffer, std::size_t size) const
+{
+    if (!buffer || size < fen_buffer_size)
+        return 0;
 
-    while (i < 8)
+    auto p = buffer;
+    for (auto row = 7; row >= 0; --row)
     {
-        if (board[i][col].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << col;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
-        }
-        else
+        auto empty = 0;
+        for (auto col : Game::one_rank)
         {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[i][col].piece.get_side() == opponent)
+            const Piece &piece = board[row][col].piece;
+            if (piece.is_empty())
             {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << col;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
+                ++empty;
+                continue;
             }
 
-            break;
-        }
+            if (empty)
+                *p++ = static_cast<char>('0' + empty);
+            empty = 0;
 
-        ++i;
-    }
+            auto letter = fen_letters[static_cast<std::uint32_t>(piece.get_rank())];
+            *p++ = (piece.get_side() == White) ? static_cast<char>(letter - ('a' - 'A')) : letter;
+        }
 
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
+        if (empty)
+            *p++ = static_cast<char>('0' + empty);
+        if (row)
+            *p++ = '/';
     }
 
-    i = row - 1;
+    *p++ = ' ';
+    *p++ = (local_side() == White) ? 'w' : 'b';
 
-    while (i >= 0)
+    *p++ = ' ';
+    if (!rules.castling)
+        *p++ = '-';
+    else
     {
-        if (board[i][col].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << col;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
-        }
-        else
-        {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[i][col].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << col;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
-            }
-
-            break;
-        }
-
-        --i;
+        if (rules.castling & WhiteKingside)
+            *p++ = 'K';
+        if (rules.castling & WhiteQueenside)
+            *p++ = 'Q';
+        if (rules.castling & BlackKingside)
+            *p++ = 'k';
+        if (rules.castling & BlackQueenside)
+            *p++ = 'q';
     }
 
-    if (target_squares.size())
+    *p++ = ' ';
+    if (rules.en_passant < 0)
+        *p++ = '-';
+    else
     {
-        paths.push_back(target_squares);
-        target_squares.clear();
+        *p++ = static_cast<char>('a' + rules.en_passant % 8);
+        *p++ = static_cast<char>('1' + rules.en_passant / 8);
     }
 
-    i = col + 1;
+    *p++ = ' ';
+    p = write_count(p, rules.halfmove_clock);
+    *p++ = ' ';
+    p = write_count(p, rules.fullmove_number);
+    *p = '\0';
 
-    while (i < 8)
-    {
-        if (board[row][i].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << row << "." << i;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
-        }
-        else
-        {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[row][i].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << row << "." << i;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
-            }
-
-            break;
-        }
-
-        ++i;
-    }
-
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
-    }
-
-    i = col - 1;
-
-    while (i >= 0)
-    {
-        if (board[row][i].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << row << "." << i;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
-        }
-        else
-        {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[row][i].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << row << "." << i;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
-            }
-
-            break;
-        }
-
-        --i;
-    }
-
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
-    }
-
-    if (!piece.has_moved())
-    {
-        // check for castle by running along the column until we hit
-        // the king, another piece, or the end of the board.  if we
-        // hit the king, and the king has not yet moved, we have a
-        // potential castle move available.
-
-        bool found_the_king = false;
-
-        // go left first
-
-        i = col - 1;
-        while (i >= 0)
-        {
-            if (board[row][i].piece.get_rank() != Piece::Rank::Empty)
-            {
-                if (board[row][i].piece.get_rank() == Piece::Rank::King && board[row][i].piece.get_side() == side &&
-                    !board[row][i].piece.has_moved())
-                {
-                    found_the_king = true;
-
-                    // we can move here
-                    std::stringstream square_name_stream;
-                    square_name_stream << "Marker.Move." << row << "." << i + 1;
-                    std::string square_name = square_name_stream.str();
-
-                    target_squares.push_back(square_name);
-                }
-
-                break;
-            }
-
-            --i;
-        }
-
-        if (!found_the_king)
-        {
-            // check right
-
-            i = col + 1;
-            while (i < 8)
-            {
-                if (board[row][i].piece.get_rank() != Piece::Rank::Empty)
-                {
-                    if (board[row][i].piece.get_rank() == Piece::Rank::King && board[row][i].piece.get_side() == side &&
-                        !board[row][i].piece.has_moved())
-                    {
-                        // we can move here
-                        std::stringstream square_name_stream;
-                        square_name_stream << "Marker.Move." << row << "." << i - 1;
-                        std::string square_name = square_name_stream.str();
-
-                        target_squares.push_back(square_name);
-                    }
-
-                    break;
-                }
-
-                ++i;
-            }
-        }
-    }
-
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
-    }
-
-    return paths;
+    return static_cast<std::size_t>(p - buffer);
 }
 
-ListStringList Chessboard::calc_bishop_moves(int row, int col)
+std::string Chessboard::to_fen() const
 {
-    // bishops move diagonally until they meet opposition or the
-    // end of the board.
-
-    auto piece = board[row][col].piece;
-
-    auto side = piece.get_side();
-    Side opponent;
-    if (side == White)
-        opponent = Black;
-    else
-        opponent = White;
+    char buffer[fen_buffer_size];
+    auto length = to_fen(buffer, sizeof(buffer));
+    return std::string(buffer, length);
+}
 
-    ListStringList paths;
+NodePtr Chessboard::get_board_mesh()
+{
+    if (!board_mesh.valid())
+        return NodePtr();
+    return board_mesh.get();
+}
 
-    StringList target_squares;
+NodePtr Chessboard::get_move_marker_mesh()
+{
+    if (!move_marker_mesh.valid())
+        return NodePtr();
+    return move_marker_mesh.get();
+}
 
-    auto i = row + 1;
-    auto j = col + 1;
+NodePtr Chessboard::get_capture_marker_mesh()
+{
+    if (!capture_marker_mesh.valid())
+        return NodePtr();
+    return capture_marker_mesh.get();
+}
 
-    while (i < 8 && j < 8)
-    {
-        if (board[i][j].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << j;
-            std::string square_name = square_name_stream.str();
+NodePtr Chessboard::get_attack_marker_mesh()
+{
+    if (!attack_marker_mesh.valid())
+        return NodePtr();
+    return attack_marker_mesh.get();
+}
 
-            target_squares.push_back(square_name);
-        }
-        else
-        {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
+// map a world-space point on the board plane to the board cell that
+// contains it.  returns false if the point is off the board.
 
-            if (board[i][j].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << j;
-                std::string square_name = square_name_stream.str();
+bool Chessboard::cell_at(double x, double y, int &row, int &col)
+{
+    // cells are 0.05 units square; columns run along X, and rows
+    // run down Y from the 1A cell
+    const Point &first_cell = board[0][0].center;
+    col = static_cast<int>(std::floor((x - first_cell.x) / 0.05 + 0.5));
+    row = static_cast<int>(std::floor((first_cell.y - y) / 0.05 + 0.5));
 
-                target_squares.push_back(square_name);
-            }
+    if (row < 0 || row > 7 || col < 0 || col > 7)
+        return false;
 
-            break;
-        }
+    float min_x, min_y, max_x, max_y;
+    std::tie(min_x, min_y, max_x, max_y) = board[row][col].get_bounds();
 
-        i++;
-        j++;
-    }
+    return x >= min_x && x <= max_x && y >= min_y && y <= max_y;
+}
 
-    if (target_squares.size())
+void Chessboard::for_each_cell_along(double x0, double y0, double x1, double y1,
+                                     const std::function<bool(int, int)> &visit)
+{
+    // in cell units, with whole numbers on the boundaries (as in cell_at)
+    const Point &first_cell = board[0][0].center;
+    auto gx0 = (x0 - first_cell.x) / 0.05 + 0.5, gy0 = (first_cell.y - y0) / 0.05 + 0.5;
+    auto dx = (x1 - first_cell.x) / 0.05 + 0.5 - gx0, dy = (first_cell.y - y1) / 0.05 + 0.5 - gy0;
+
+    auto col = static_cast<int>(std::floor(gx0));
+    auto row = static_cast<int>(std::floor(gy0));
+    int step_col = dx > 0. ? 1 : -1, step_row = dy > 0. ? 1 : -1;
+
+    // how far along the line (0 to 1) the next boundary of each kind is,
+    // and how far apart they are
+    const double never = 2.;
+    auto next_col = dx != 0. ? ((step_col > 0 ? col + 1 : col) - gx0) / dx : never;
+    auto next_row = dy != 0. ? ((step_row > 0 ? row + 1 : row) - gy0) / dy : never;
+    auto col_spacing = dx != 0. ? step_col / dx : never;
+    auto row_spacing = dy != 0. ? step_row / dy : never;
+
+    while (true)
     {
-        paths.push_back(target_squares);
-        target_squares.clear();
-    }
+        if (row >= 0 && row <= 7 && col >= 0 && col <= 7 && !visit(row, col))
+            return;
 
-    i = row + 1;
-    j = col - 1;
+        if (next_col > 1. && next_row > 1.)
+            return;
 
-    while (i < 8 && j >= 0)
-    {
-        if (board[i][j].piece.get_rank() == Piece::Rank::Empty)
+        if (next_col < next_row)
         {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << j;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
+            col += step_col;
+            next_col += col_spacing;
         }
         else
         {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[i][j].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << j;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
-            }
-
-            break;
+            row += step_row;
+            next_row += row_spacing;
         }
-
-        i++;
-        --j;
-    }
-
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
     }
+}
 
-    i = row - 1;
-    j = col + 1;
+Chessboard::Cell *Chessboard::find_piece(int id)
+{
+    if (id < 0)
+        return nullptr;
 
-    while (i >= 0 && j < 8)
+    for (auto row : Game::one_rank)
     {
-        if (board[i][j].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << j;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
-        }
-        else
+        for (auto col : Game::one_rank)
         {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[i][j].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << j;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
-            }
-
-            break;
+            if (board[row][col].has_piece() && board[row][col].piece.get_id() == id)
+                return &board[row][col];
         }
-
-        --i;
-        j++;
     }
 
-    if (target_squares.size())
+    // check the capture squares
+
+    for (auto i : Game::one_side)
     {
-        paths.push_back(target_squares);
-        target_squares.clear();
+        if (black_capture[i].has_piece() && black_capture[i].piece.get_id() == id)
+            return &black_capture[i];
+        if (white_capture[i].has_piece() && white_capture[i].piece.get_id() == id)
+            return &white_capture[i];
     }
 
-    i = row - 1;
-    j = col - 1;
+    return nullptr;
+}
 
-    while (i >= 0 && j >= 0)
+void Chessboard::for_each_piece(const std::function<void(const Piece &, const Cell &)> &visit) const
+{
+    for (auto row : Game::one_rank)
     {
-        if (board[i][j].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << j;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
-        }
-        else
+        for (auto col : Game::one_rank)
         {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[i][j].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << j;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
-            }
-
-            break;
+            if (board[row][col].has_piece())
+                visit(board[row][col].piece, board[row][col]);
         }
-
-        --i;
-        --j;
     }
 
-    if (target_squares.size())
+    for (auto i : Game::one_side)
     {
-        paths.push_back(target_squares);
-        target_squares.clear();
+        if (white_capture[i].has_piece())
+            visit(white_capture[i].piece, white_capture[i]);
+        if (black_capture[i].has_piece())
+            visit(black_capture[i].piece, black_capture[i]);
     }
-
-    return paths;
 }
 
-ListStringList Chessboard::calc_king_moves(int row, int col)
+bool Chessboard::select(Cell &cell)
 {
-    // the king can move any direction, but only one square at a time.
-
-    auto piece = board[row][col].piece;
-
-    auto side = piece.get_side();
-    Side opponent;
-    if (side == White)
-        opponent = Black;
-    else
-        opponent = White;
-
-    ListStringList paths;
-
-    // the king cannot move if he is in check, unless the move gets him
-    // out of check
-
-    if (piece.is_checked())
-        return paths;
-
-    // check the eight squares around me
-
-    int squares[][2] = {{row - 1, col}, {row - 1, col - 1}, {row - 1, col + 1}, {row, col - 1},
-                        {row, col + 1}, {row + 1, col},     {row + 1, col - 1}, {row + 1, col + 1}};
-
-    for (int i = 0; i < 8; i++)
-    {
-        auto r = squares[i][0];
-        auto c = squares[i][1];
-
-        if (r < 0 || r > 7 || c < 0 || c > 7)
-            continue;
-
-        if (board[r][c].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << r << "." << c;
-            std::string square_name = square_name_stream.str();
-
-            StringList target_squares;
-            target_squares.push_back(square_name);
-            paths.push_back(target_squares);
-        }
-        else
-        {
-            // a piece is in our way.  if it is an opposing piece, we
-            // can move to this square (attack)
+    if (!board[cell.row][cell.col].has_piece())
+        return false;
 
-            if (board[r][c].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << r << "." << c;
-                std::string square_name = square_name_stream.str();
-
-                StringList target_squares;
-                target_squares.push_back(square_name);
-                paths.push_back(target_squares);
-            }
-        }
-    }
+    selected = Position(cell.row, cell.col);
 
-    return paths;
+    return true;
 }
 
-ListStringList Chessboard::calc_queen_moves(int row, int col)
+bool Chessboard::select(Piece &piece)
 {
-    // the queen can move any direction, any number of squares
-    // at a time, until another piece, or the end of the board,
-    // is encountered
-
-    auto piece = board[row][col].piece;
-
-    auto side = piece.get_side();
-    Side opponent;
-    if (side == White)
-        opponent = Black;
-    else
-        opponent = White;
-
-    ListStringList paths;
-
-    StringList target_squares;
+    if (piece.is_captured())
+        return false;
 
-    auto i = row + 1;
-    auto j = col + 1;
+    selected = piece.get_position();
 
-    while (i < 8 && j < 8)
-    {
-        if (board[i][j].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << j;
-            std::string square_name = square_name_stream.str();
+    return true;
+}
 
-            target_squares.push_back(square_name);
-        }
-        else
-        {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
+// a promoted pawn keeps its id, but takes a new rank (and so mesh), and
+// a new name to go with it
 
-            if (board[i][j].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << j;
-                std::string square_name = square_name_stream.str();
+void Chessboard::promote(Piece &piece, Piece::Rank rank)
+{
+    if (rank != Piece::Rank::Rook && rank != Piece::Rank::Knight && rank != Piece::Rank::Bishop)
+        rank = Piece::Rank::Queen;
 
-                target_squares.push_back(square_name);
-            }
+    piece.set_rank(rank);
+    piece.set_name(nullptr);
+}
 
-            break;
-        }
+// random numbers for each piece on each cell, and for the other parts of
+// a position, made from a fixed seed (so keys can be stored)
 
-        i++;
-        j++;
-    }
+struct ZobristKeys
+{
+    std::uint64_t pieces[12][64];
+    std::uint64_t black_to_move;
+    std::uint64_t castling[16];
+    std::uint64_t en_passant[8];
 
-    if (target_squares.size())
+    ZobristKeys()
     {
-        paths.push_back(target_squares);
-        target_squares.clear();
+        // splitmix64
+        std::uint64_t state = 0x4f53474368657373ull;
+        auto next = [&state]() {
+            auto z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        };
+
+        for (auto &piece : pieces)
+            for (auto &cell : piece)
+                cell = next();
+        black_to_move = next();
+        for (auto &rights : castling)
+            rights = next();
+        for (auto &file : en_passant)
+            file = next();
     }
+};
 
-    i = row + 1;
+std::uint64_t Chessboard::position_key() const
+{
+    static const ZobristKeys keys;
+    auto side = local_side();
 
-    while (i < 8)
+    std::uint64_t key = 0;
+    for (auto row = 0; row < 8; ++row)
     {
-        if (board[i][col].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << col;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
-        }
-        else
+        for (auto col = 0; col < 8; ++col)
         {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[i][col].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << col;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
-            }
+            const Piece &piece = board[row][col].piece;
+            if (piece.is_empty())
+                continue;
 
-            break;
+            auto kind = (static_cast<std::uint32_t>(piece.get_rank()) - 1) * 2 + (piece.get_side() == Black ? 1 : 0);
+            key ^= keys.pieces[kind][row * 8 + col];
         }
-
-        ++i;
-    }
-
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
     }
 
-    i = row + 1;
-    j = col - 1;
+    if (side == Black)
+        key ^= keys.black_to_move;
+    key ^= keys.castling[rules.castling & 15];
 
-    while (i < 8 && j >= 0)
+    // a double step only makes a new position if a pawn can take it
+    if (rules.en_passant >= 0)
     {
-        if (board[i][j].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << j;
-            std::string square_name = square_name_stream.str();
+        auto row = rules.en_passant / 8;
+        auto col = rules.en_passant % 8;
+        auto pawn_row = (side == White) ? row - 1 : row + 1;
 
-            target_squares.push_back(square_name);
-        }
-        else
+        for (auto c : {col - 1, col + 1})
         {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
+            if (c < 0 || c > 7)
+                continue;
 
-            if (board[i][j].piece.get_side() == opponent)
+            const Piece &piece = board[pawn_row][c].piece;
+            if (piece.get_rank() == Piece::Rank::Pawn && piece.get_side() == side)
             {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << j;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
+                key ^= keys.en_passant[col];
+                break;
             }
-
-            break;
         }
-
-        i++;
-        --j;
     }
 
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
-    }
+    return key;
+}
 
-    j = col - 1;
+// the ranks and sides of the pieces, as the rules keep them
 
-    while (j >= 0)
+void Chessboard::sync_rules()
+{
+    for (auto row : Game::one_rank)
     {
-        if (board[row][j].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << row << "." << j;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
-        }
-        else
+        for (auto col : Game::one_rank)
         {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[row][j].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << row << "." << j;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
-            }
-
-            break;
+            const Piece &piece = board[row][col].piece;
+            rules.cells[row * 8 + col] =
+                piece.is_empty() ? std::uint8_t(Rules::Empty) : Rules::piece(static_cast<int>(piece.get_rank()), piece.get_side());
         }
-
-        --j;
-    }
-
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
     }
+}
 
-    j = col + 1;
-
-    while (j < 8)
-    {
-        if (board[row][j].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << row << "." << j;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
-        }
-        else
-        {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[row][j].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << row << "." << j;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
-            }
+bool Chessboard::move_selected_to(int row, int col, Piece::Rank promotion)
+{
+    int selected_row, selected_col;
+    std::tie(selected_row, selected_col) = selected;
 
-            break;
-        }
+    if (!board[selected_row][selected_col].has_piece())
+        return false;
 
-        ++j;
-    }
+    auto mover = board[selected_row][selected_col].piece.get_rank();
+    auto capture = board[row][col].has_piece();
 
-    if (target_squares.size())
+    // a pawn moving diagonally onto an empty cell takes en passant; the
+    // pawn it takes stands beside that cell
+    auto victim_row = row;
+    if (mover == Piece::Rank::Pawn && col != selected_col && !capture)
     {
-        paths.push_back(target_squares);
-        target_squares.clear();
+        victim_row = selected_row;
+        capture = board[victim_row][col].has_piece();
     }
 
-    i = row - 1;
-    j = col + 1;
+    // the rules board keeps the FEN state (castling rights, en passant
+    // cell, clocks and the side to move) current; the pieces follow
+    auto moving_side = local_side();
+    auto promoted = static_cast<Piece::Rank>(
+        Rules::make_move(rules, selected_row, selected_col, row, col, static_cast<int>(promotion)));
 
-    while (i >= 0 && j < 8)
+    if (capture)
     {
-        if (board[i][j].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << j;
-            std::string square_name = square_name_stream.str();
-
-            target_squares.push_back(square_name);
-        }
-        else
-        {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
-
-            if (board[i][j].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << j;
-                std::string square_name = square_name_stream.str();
-
-                target_squares.push_back(square_name);
-            }
-
-            break;
-        }
+        // it's an opposing piece; this is an attack.
+        // move the piece to my next available capture
+        // spot
 
-        --i;
-        j++;
-    }
+        Cell &holding = (moving_side == White) ? white_capture[white_capture_index++]
+                                               : black_capture[black_capture_index++];
+        holding.piece = board[victim_row][col].piece;
+        board[victim_row][col].piece.clear();
 
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
+        notify_piece_moved(holding.piece, holding);
     }
 
-    i = row - 1;
+    board[row][col].piece = board[selected_row][selected_col].piece;
+    board[row][col].piece.move_to(row, col);
+    board[selected_row][selected_col].piece.clear();
 
-    while (i >= 0)
-    {
-        if (board[i][col].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << col;
-            std::string square_name = square_name_stream.str();
+    if (promoted != Piece::Rank::Empty)
+        promote(board[row][col].piece, promoted);
 
-            target_squares.push_back(square_name);
-        }
-        else
-        {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
+    notify_piece_moved(board[row][col].piece, board[row][col]);
 
-            if (board[i][col].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << col;
-                std::string square_name = square_name_stream.str();
+    // castling: the king has moved two cells, and the rook hops over it
 
-                target_squares.push_back(square_name);
-            }
+    if (mover == Piece::Rank::King && std::abs(col - selected_col) == 2)
+    {
+        auto rook_col = (col == 6) ? 7 : 0;
+        auto rook_to = (col == 6) ? 5 : 3;
 
-            break;
-        }
+        board[row][rook_to].piece = board[row][rook_col].piece;
+        board[row][rook_to].piece.move_to(row, rook_to);
+        board[row][rook_col].piece.clear();
 
-        --i;
+        notify_piece_moved(board[row][rook_to].piece, board[row][rook_to]);
     }
 
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
-    }
+    notify_side_changed();
+    notify_move_made(selected_row, selected_col, row, col, promoted);
 
-    i = row - 1;
-    j = col - 1;
+    return true;
+}
 
-    while (i >= 0 && j >= 0)
-    {
-        if (board[i][j].piece.get_rank() == Piece::Rank::Empty)
-        {
-            // we can move here
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << i << "." << j;
-            std::string square_name = square_name_stream.str();
+bool Chessboard::move_to(const Piece &/*piece*/, int /*row*/, int /*col*/)
+{
+    return false;
+}
 
-            target_squares.push_back(square_name);
-        }
-        else
-        {
-            // a piece is in our way, so we stop here.  if it is
-            // an opposing piece, we can move to this square (attack)
+// the cells a piece may move to, as bitmasks (see Rules)
 
-            if (board[i][j].piece.get_side() == opponent)
-            {
-                // we can move here
-                std::stringstream square_name_stream;
-                square_name_stream << "Marker.Attack." << i << "." << j;
-                std::string square_name = square_name_stream.str();
+Chessboard::MoveMask Chessboard::valid_moves(Cell &cell)
+{
+    int row, col;
+    std::tie(row, col) = cell.get_position();
+    return valid_moves(row, col);
+}
 
-                target_squares.push_back(square_name);
-            }
+Chessboard::MoveMask Chessboard::valid_moves(int row, int col)
+{
+    ProfileScope scope(Profiler::MoveGeneration);
+    return Rules::valid_moves(rules, row, col);
+}
 
-            break;
-        }
+Chessboard::MoveMask Chessboard::legal_moves(Cell &cell)
+{
+    int row, col;
+    std::tie(row, col) = cell.get_position();
+    return legal_moves(row, col);
+}
 
-        --i;
-        --j;
-    }
+Chessboard::MoveMask Chessboard::legal_moves(int row, int col)
+{
+    ProfileScope scope(Profiler::MoveGeneration);
+    return Rules::legal_moves(rules, row, col);
+}
 
-    if (target_squares.size())
-    {
-        paths.push_back(target_squares);
-        target_squares.clear();
-    }
+bool Chessboard::is_legal(int from_row, int from_col, int to_row, int to_col)
+{
+    return Rules::is_legal(rules, from_row, from_col, to_row, to_col);
+}
 
-    return paths;
+bool Chessboard::is_attacked(int row, int col, Side by) const
+{
+    return Rules::is_attacked(rules, row, col, by);
+}
+
+bool Chessboard::in_check(Side side) const
+{
+    return Rules::in_check(rules, side);
 }
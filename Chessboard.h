@@ -24,9 +24,11 @@
 // IN THE SOFTWARE.
 //------------------------------------------------------------------------------
 
+#include <functional>
 #include <memory>
 
 #include "OSG.h"
+#include "Rules.h"
 
 using Position = std::tuple<int, int>;
 using Bounds = std::tuple<float, float, float, float>;
@@ -96,8 +98,9 @@ public:
             side = White;
         }
 
-        NodePtr get_mesh();
-        void load_mesh(const std::string &id);
+        // the mesh every piece of this side and rank draws, once a scene
+        // board has loaded them (see Chessboard's constructor)
+        NodePtr get_mesh() const;
 
         bool is_empty() const
         {
@@ -124,14 +127,24 @@ public:
         }
         void capture();
 
-        void set_name(const std::string &name_)
+        // names from the opening setup are static strings; pieces without
+        // one (promoted, or extras from a FEN record) are named on demand
+        void set_name(const char *name_)
         {
             name = name_;
         }
-        std::string get_name() const
+
+        // a small number identifying the piece on its board for as long
+        // as the board isn't reset (-1 if it has none)
+        int get_id() const
+        {
+            return id;
+        }
+        void set_id(int id_)
         {
-            return name;
+            id = id_;
         }
+        std::string get_name() const;
 
         bool has_moved() const
         {
@@ -139,6 +152,15 @@ public:
         }
         void move_to(int row_, int col_);
 
+        // put the piece on a cell without making a move
+        void place(int row_, int col_, bool moved_)
+        {
+            row = row_;
+            col = col_;
+            first_move = !moved_;
+            captured = false;
+        }
+
         void checked(bool checked_ = true)
         {
             in_check = checked_;
@@ -161,7 +183,8 @@ public:
         bool first_move{true};
         bool in_check{false};
 
-        std::string name;
+        int id{-1};
+        const char *name{nullptr};
     };
 
     class Cell
@@ -211,12 +234,162 @@ public:
         Bounds get_bounds();
     };
 
+    // the cells a piece may move to, one bit per board cell
+    using MoveMask = Rules::MoveMask;
+
+    static std::uint64_t cell_bit(int row, int col)
+    {
+        return Rules::cell_bit(row, col);
+    }
+
+    // castling rights, one bit each (as the "KQkq" field of a FEN record)
+
+    enum Castling : std::uint8_t
+    {
+        WhiteKingside = Rules::WhiteKingside,
+        WhiteQueenside = Rules::WhiteQueenside,
+        BlackKingside = Rules::BlackKingside,
+        BlackQueenside = Rules::BlackQueenside
+    };
+
+    // FenPosition -- a parsed FEN record.  It's plain data, so parsing
+    // one allocates nothing; set_position() puts it on the board.  Cells
+    // are [row][col], with row 0 being rank 1 and col 0 being file a.
+
+    struct FenPosition
+    {
+        Piece::Rank ranks[8][8];
+        Side sides[8][8];
+        Side to_move;
+        std::uint8_t castling;      // Castling bits
+        int en_passant;             // the cell (row * 8 + col) passed over by a double step, or -1
+        int halfmove_clock;         // plies since the last capture or pawn move
+        int fullmove_number;        // starts at 1, and counts up after each Black move
+    };
+
+    // room for the longest FEN to_fen() can produce, and its terminator
+    static const std::size_t fen_buffer_size = 128;
+
+    // Listener -- receives notification of changes made to the board, so
+    // observers (like the scene graph) do not need to poll for them.
+
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+
+        // a piece has been placed in a new cell (a board cell, or a
+        // holding cell if it was captured)
+        virtual void piece_moved(const Piece &piece, const Cell &cell) = 0;
+
+        // the whole board has been replaced (e.g., a new position was set)
+        virtual void board_reset() = 0;
+
+        // the turn has passed to the other side
+        virtual void side_changed(Side side) = 0;
+
+        // the same pieces have been rearranged all at once (e.g., the
+        // state was set, or notifications were held over several moves)
+        virtual void position_changed() = 0;
+
+        // a move has been completed (promotion is Empty unless a pawn
+        // promoted); most listeners only need piece_moved()
+        virtual void move_made(int /*from_row*/, int /*from_col*/, int /*to_row*/, int /*to_col*/,
+                               Piece::Rank /*promotion*/)
+        {}
+    };
+
+    // State -- all there is to the position, down to which piece (by id)
+    // stands where, so set_state() can put the board back exactly as it
+    // was without the scene having to start over
+
+    struct State
+    {
+        Piece board[8][8];
+        Piece white_capture[16];
+        Piece black_capture[16];
+        int white_capture_index;
+        int black_capture_index;
+        Side to_move;
+        std::uint8_t castling;
+        int en_passant;
+        int halfmove_clock;
+        int fullmove_number;
+    };
+
 public:
-    Chessboard();
+    // what a board is for: the scene, where the pieces have meshes, or
+    // just following a position, as the batch tools do (such boards never
+    // touch the meshes, so they can be made on any thread)
+    enum class Use
+    {
+        Scene,
+        Position
+    };
+
+    explicit Chessboard(Use use = Use::Scene);
     virtual ~Chessboard() {}
 
     void reset();
 
+    // FEN import and export.  The parser is strict: all six fields (or
+    // just the first four, with the clocks then taken as "0 1"), single
+    // spaces between them, one king per side, no pawns on the back ranks,
+    // and castling and en passant fields that agree with the pieces.
+
+    static bool parse_fen(const char *fen, std::size_t length, FenPosition &position);
+    void set_position(const FenPosition &position);
+    bool set_fen(const char *fen, std::size_t length);
+    bool set_fen(const std::string &fen)
+    {
+        return set_fen(fen.data(), fen.size());
+    }
+
+    // writes the position as FEN into buffer (see fen_buffer_size), and
+    // returns its length; 0 if the buffer is too small
+    std::size_t to_fen(char *buffer, std::size_t size) const;
+    std::string to_fen() const;
+
+    // a Zobrist hash of the position: the pieces, the side to move, the
+    // castling rights and (if it can be taken) the en passant cell.  Keys
+    // are the same from run to run, so they may be stored.
+    std::uint64_t position_key() const;
+
+    std::uint8_t get_castling() const
+    {
+        return rules.castling;
+    }
+    int get_en_passant() const
+    {
+        return rules.en_passant;
+    }
+    int get_halfmove_clock() const
+    {
+        return rules.halfmove_clock;
+    }
+    int get_fullmove_number() const
+    {
+        return rules.fullmove_number;
+    }
+
+    // the position as the rules see it
+    const Rules::Board &get_rules_board() const
+    {
+        return rules;
+    }
+
+    void get_state(State &state) const;
+    void set_state(const State &state);
+
+    void add_listener(Listener *listener);
+    void remove_listener(Listener *listener);
+
+    // hold back notifications until the matching release, which then sends
+    // a single board_reset() or position_changed() for all that happened
+    // meanwhile (moves made while held aren't reported by move_made())
+    void hold_notifications();
+    void release_notifications();
+
     NodePtr get_board_mesh();
     NodePtr get_move_marker_mesh();
     NodePtr get_capture_marker_mesh();
@@ -227,12 +400,21 @@ public:
         return board[row][col];
     }
 
-    bool is_piece(const std::string &node_id);
-    Cell &find_piece(const std::string &name);
+    bool cell_at(double x, double y, int &row, int &col);
+
+    // visit the cells the line between two points passes over, one cell
+    // boundary at a time from the first point, until the visit returns false
+    void for_each_cell_along(double x0, double y0, double x1, double y1, const std::function<bool(int, int)> &visit);
+
+    // the cell holding the piece with the given id, or nullptr
+    Cell *find_piece(int id);
+
+    // visit every piece, in play or captured, along with the cell it's in
+    void for_each_piece(const std::function<void(const Piece &, const Cell &)> &visit) const;
 
     Side local_side() const
     {
-        return this_side;
+        return static_cast<Side>(rules.to_move);
     }
 
     void clear_selection()
@@ -246,12 +428,24 @@ public:
         return selected;
     }
 
-    bool move_selected_to(int row, int col);
+    // a pawn reaching the far rank becomes the promotion rank (a queen,
+    // rook, bishop or knight; anything else gives a queen)
+    bool move_selected_to(int row, int col, Piece::Rank promotion = Piece::Rank::Queen);
     bool move_to(const Piece &piece, int row, int col);
 
-    ListStringList valid_paths(int row, int col);
-    ListStringList valid_paths(Cell &cell);
-    ListStringList valid_paths(Piece &cell);
+    MoveMask valid_moves(int row, int col);
+    MoveMask valid_moves(Cell &cell);
+
+    // valid_moves(), less any that would leave the mover's king attacked
+    MoveMask legal_moves(int row, int col);
+    MoveMask legal_moves(Cell &cell);
+
+    // can the piece on the first cell move to the second?
+    bool is_legal(int from_row, int from_col, int to_row, int to_col);
+
+    // is the cell attacked by a piece of the given side?
+    bool is_attacked(int row, int col, Side by) const;
+    bool in_check(Side side) const;
 
 protected: // data members
     Cell board[8][8];
@@ -262,24 +456,33 @@ protected: // data members
     int black_capture_index{0};
     Cell black_capture[16];
 
-    Side this_side{White};
+    // the ranks and sides of the pieces on the board, the side to move,
+    // castling rights, en passant cell and clocks (see Rules)
+    Rules::Board rules;
 
     Position selected;
 
-    static MeshMap mesh_map;
+    std::vector<Listener *> listeners;
+    int notifications_held{0};
+    bool held_change{false};
+    bool held_reset{false};
+
+    // loaded once, by the first scene board made
+    static NodePtr piece_meshes[3][7];  // by side and rank; shared by every board
     static NodePtr board_mesh;
     static NodePtr move_marker_mesh;
     static NodePtr capture_marker_mesh;
     static NodePtr attack_marker_mesh;
 
 protected: // methods
-    ListStringList calc_valid_paths(int row, int col);
-    ListStringList calc_pawn_moves(int row, int col);
-    ListStringList calc_knight_moves(int row, int col);
-    ListStringList calc_rook_moves(int row, int col);
-    ListStringList calc_bishop_moves(int row, int col);
-    ListStringList calc_king_moves(int row, int col);
-    ListStringList calc_queen_moves(int row, int col);
+    void notify_piece_moved(const Piece &piece, const Cell &cell);
+    void notify_board_reset();
+    void notify_side_changed();
+    void notify_position_changed();
+    void notify_move_made(int from_row, int from_col, int to_row, int to_col, Piece::Rank promotion);
+
+    void sync_rules();
+    void promote(Piece &piece, Piece::Rank rank);
 };
 
 using ChessboardPtr = osg::ref_ptr<Chessboard>;
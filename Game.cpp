@@ -24,85 +24,202 @@
 
 #include "Game.h"
 #include "Callbacks.h"
+#include "Profiler.h"
+#include "NodeTags.h"
 
 // these may be overkill (because the board size will never change) but they improve code readability
 const std::vector<int> Game::one_rank{0, 1, 2, 3, 4, 5, 6, 7};
 const std::vector<int> Game::one_side{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
 const std::vector<int> Game::white_ranks{0, 1};
-const std::vector<int> Game::center_ranks{2, 3, 4, 6};
+const std::vector<int> Game::center_ranks{2, 3, 4, 5};
 const std::vector<int> Game::black_ranks{6, 7};
 
-Game::Game()
+// how fast the attack markers spin (radians per second)
+static const double marker_spin = 0.6;
+
+Game::Game(LodBuilderPtr lod_builder_) : lod_builder(lod_builder_)
 {
+    if (!lod_builder.valid())
+        lod_builder = new LodBuilder(default_detail_levels());
+
     sg_root = createScene();
+    chessboard->add_listener(this);
 }
 
-void Game::construct_move_squares(ChessboardPtr chessboard, GroupPtr &squares)
+Game::~Game()
 {
-    Chessboard &cb = *chessboard;
+    chessboard->remove_listener(this);
+}
+
+void Game::piece_moved(const Chessboard::Piece &, const Chessboard::Cell &)
+{
+    publish_snapshot();
+}
+
+void Game::side_changed(Chessboard::Side)
+{
+    publish_snapshot();
+}
+
+void Game::position_changed()
+{
+    // the same pieces, so the scene can move them rather than rebuild
+    highlighted = Chessboard::MoveMask();
+    publish_snapshot();
+}
+
+void Game::publish_snapshot()
+{
+    snapshots.publish(new BoardSnapshot(*chessboard, highlighted, layout));
+    request_frame();
+}
+
+void Game::update_scene()
+{
+    if (!snapshots.latch())
+        return;
+
+    auto snapshot = snapshots.current();
+
+    // the same pieces as last time?  then animate the ones that moved;
+    // otherwise start over
 
-    for (auto row : Game::one_rank)
+    auto same_pieces = applied.valid() && applied->layout == snapshot->layout &&
+                       applied->placements.size() == snapshot->placements.size();
+
+    if (same_pieces)
     {
-        for (auto col : Game::one_rank)
+        for (std::size_t i = 0; i < snapshot->placements.size(); ++i)
         {
-            auto cell = cb(row, col);
-            auto center = cell.get_center();
+            const auto &placement = snapshot->placements[i];
+            const auto &previous = applied->placements[i];
 
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Move." << row << "." << col;
-            auto square_name = square_name_stream.str();
+            // (a promoted pawn keeps its id, but needs a new mesh)
+            if (placement.id != previous.id || placement.mesh != previous.mesh)
+            {
+                same_pieces = false;
+                break;
+            }
 
-            osg::ref_ptr<osg::Switch> switch_node(new osg::Switch);
-            switch_node->setNewChildDefaultValue(false);
-            switch_node->setName(square_name.c_str());
-            switch_node->setDataVariance(osg::Object::DYNAMIC);
+            if (placement.position == previous.position)
+                continue;
 
-            osg::Matrix square_matrix;
-            square_matrix.makeTranslate(center.x, center.y, 0.021);
+            if (placement.id < 0 || placement.id >= static_cast<int>(piece_nodes.size()) || !piece_nodes[placement.id].valid())
+                continue;
 
-            osg::ref_ptr<osg::MatrixTransform> mt(new osg::MatrixTransform(square_matrix));
-            mt->addChild(cb.get_move_marker_mesh());
-            mt->setDataVariance(osg::Object::STATIC);
+            // captured pieces fly off to their holding cell, and knights
+            // jump; everything else slides along the board
 
-            switch_node->addChild(mt);
+            auto arc_height = 0.;
+            if (placement.held && !previous.held)
+                arc_height = 0.1;
+            else if (placement.rank == Chessboard::Piece::Rank::Knight)
+                arc_height = 0.06;
 
-            squares->addChild(switch_node);
+            animator->add(new PieceTween(piece_nodes[placement.id].get(), placement.position, arc_height));
         }
     }
+
+    if (!same_pieces)
+    {
+        ProfileScope scope(Profiler::SceneRebuild);
+
+        for (const auto &node : piece_nodes)
+            animator->remove(node.get());
+
+        piece_nodes.clear();
+        pieces->removeChildren(0, pieces->getNumChildren());
+        construct_pieces(*snapshot, pieces);
+    }
+
+    {
+        ProfileScope scope(Profiler::Highlighting);
+
+        move_markers->set_mask(snapshot->highlights.moves);
+        capture_markers->set_mask(snapshot->highlights.captures);
+    }
+
+    if (snapshot->local_side != marker_side)
+        show_attack_marker(snapshot->local_side);
+
+    applied = snapshot;
 }
 
-void Game::construct_capture_squares(ChessboardPtr chessboard, GroupPtr &squares)
+void Game::set_marker_spin(bool spin)
 {
-    Chessboard &cb = *chessboard;
+    marker_spin_enabled = spin;
+    spin_attack_marker();
+}
 
-    for (auto row : Game::one_rank)
-    {
-        for (auto col : Game::one_rank)
-        {
-            auto cell = cb(row, col);
-            auto center = cell.get_center();
+void Game::spin_attack_marker()
+{
+    // the hidden marker has no need to move
+    animator->remove(white_spinner.get());
+    animator->remove(black_spinner.get());
 
-            std::stringstream square_name_stream;
-            square_name_stream << "Marker.Attack." << row << "." << col;
-            auto square_name = square_name_stream.str();
+    if (!marker_spin_enabled)
+        return;
 
-            osg::ref_ptr<osg::Switch> switch_node(new osg::Switch);
-            switch_node->setNewChildDefaultValue(false);
-            switch_node->setName(square_name.c_str());
-            switch_node->setDataVariance(osg::Object::DYNAMIC);
+    if (marker_side == Chessboard::White)
+        animator->add(new SpinTween(white_spinner.get(), osg::Vec3d(0., 1., 0.), marker_spin));
+    else
+        animator->add(new SpinTween(black_spinner.get(), osg::Vec3d(0., 1., 0.), -marker_spin));
+}
 
-            osg::Matrix square_matrix;
-            square_matrix.makeTranslate(center.x, center.y, 0.021);
+// called only when the side changes, rather than polled every frame
 
-            osg::ref_ptr<osg::MatrixTransform> mt(new osg::MatrixTransform(square_matrix));
-            mt->addChild(cb.get_capture_marker_mesh());
-            mt->setDataVariance(osg::Object::DYNAMIC);
+void Game::show_attack_marker(Chessboard::Side side)
+{
+    ProfileScope scope(Profiler::AttackMarkers);
 
-            switch_node->addChild(mt);
+    marker_side = side;
+    white_marker->setValue(0, side == Chessboard::White);
+    black_marker->setValue(0, side == Chessboard::Black);
 
-            squares->addChild(switch_node);
-        }
-    }
+    spin_attack_marker();
+}
+
+bool Game::needs_frame()
+{
+    return animator->is_animating() || frame_requested.exchange(false);
+}
+
+void Game::board_reset()
+{
+    // the pieces may all be different; the scene will rebuild them
+    ++layout;
+    highlighted = Chessboard::MoveMask();
+    publish_snapshot();
+}
+
+osg::Matrix Game::get_home_view() const
+{
+    osg::Matrix lookAt;
+    lookAt.makeLookAt(osg::Vec3(0.5f, -0.5f, 1.f), centerScope, osg::Vec3(0.0f, 0.0f, 1.0f));
+    return lookAt;
+}
+
+Chessboard::MoveMask Game::get_highlighted() const
+{
+    return highlighted;
+}
+
+void Game::highlight_moves(const Chessboard::MoveMask &mask)
+{
+    highlighted = mask;
+    publish_snapshot();
+}
+
+void Game::construct_move_squares(ChessboardPtr chessboard, GroupPtr &squares)
+{
+    move_markers = new InstancedMarkers(chessboard, chessboard->get_move_marker_mesh(), "Marker.Move");
+    squares->addChild(move_markers->get_node().get());
+}
+
+void Game::construct_capture_squares(ChessboardPtr chessboard, GroupPtr &squares)
+{
+    capture_markers = new InstancedMarkers(chessboard, chessboard->get_capture_marker_mesh(), "Marker.Attack");
+    squares->addChild(capture_markers->get_node().get());
 }
 
 void Game::construct_attack_markers(ChessboardPtr chessboard, GroupPtr &attack_group)
@@ -118,16 +235,17 @@ void Game::construct_attack_markers(ChessboardPtr chessboard, GroupPtr &attack_g
         patt->setPosition(pos);
         patt->setAttitude(att);
         patt->setDataVariance(osg::Object::DYNAMIC);
-        patt->addChild(cb.get_attack_marker_mesh());
-        patt->setUpdateCallback(new RotateAttackMarkerCallback());
+        patt->addChild(lod_builder->get(cb.get_attack_marker_mesh()));
+        white_spinner = patt;
         patt->setName("Rotate.White.Attack.Marker");
+        NodeTag::set(patt.get(), NodeTag::Kind::AttackMarker, Chessboard::White);
 
         osg::ref_ptr<osg::Switch> switch_node(new osg::Switch);
         switch_node->setNewChildDefaultValue(true);
         switch_node->setName("Switch.White.Attack.Marker");
         switch_node->addChild(patt.get());
-        switch_node->setUpdateCallback(new EnableAttackMarkerCallback(chessboard));
         switch_node->setDataVariance(osg::Object::DYNAMIC);
+        white_marker = switch_node;
 
         attack_group->addChild(switch_node.get());
     }
@@ -141,9 +259,10 @@ void Game::construct_attack_markers(ChessboardPtr chessboard, GroupPtr &attack_g
         patt1->setPosition(pos1);
         patt1->setAttitude(att1);
         patt1->setDataVariance(osg::Object::DYNAMIC);
-        patt1->addChild(cb.get_attack_marker_mesh());
-        patt1->setUpdateCallback(new RotateAttackMarkerCallback());
+        patt1->addChild(lod_builder->get(cb.get_attack_marker_mesh()));
+        black_spinner = patt1;
         patt1->setName("Rotate.Black.Attack.Marker");
+        NodeTag::set(patt1.get(), NodeTag::Kind::AttackMarker, Chessboard::Black);
 
         osg::Vec3d pos2(-0.275, -0.175, 0.0);
         osg::Vec3d axis2(0., 0., 1.);
@@ -160,13 +279,53 @@ void Game::construct_attack_markers(ChessboardPtr chessboard, GroupPtr &attack_g
         switch_node->setNewChildDefaultValue(false);
         switch_node->setName("Switch.Black.Attack.Marker");
         switch_node->addChild(patt2.get());
-        switch_node->setUpdateCallback(new EnableAttackMarkerCallback(chessboard));
         switch_node->setDataVariance(osg::Object::DYNAMIC);
+        black_marker = switch_node;
 
         attack_group->addChild(switch_node.get());
     }
 }
 
+void Game::construct_pieces(const BoardSnapshot &snapshot, GroupPtr &piece_group)
+{
+    for (const auto &placement : snapshot.placements)
+    {
+        osg::Vec3d axis(0., 0., 1.);
+        osg::Quat att(M_PI * static_cast<double>(placement.facing), axis);
+
+        osg::ref_ptr<osg::PositionAttitudeTransform> patt(new osg::PositionAttitudeTransform);
+        patt->setPosition(placement.position);
+        patt->setAttitude(att);
+        patt->setDataVariance(osg::Object::DYNAMIC);
+        patt->addChild(lod_builder->get(placement.mesh));
+        patt->setName(placement.name);
+        NodeTag::set(patt.get(), NodeTag::Kind::Piece, placement.id);
+
+        if (placement.id >= static_cast<int>(piece_nodes.size()))
+            piece_nodes.resize(placement.id + 1);
+        piece_nodes[placement.id] = patt;
+
+        piece_group->addChild(patt.get());
+    }
+}
+
+// pieces and attack markers share a few StateSets between them (see
+// share_state()); drawing them from a bin sorted by state first keeps
+// the GL state changes per frame down to about one per material, and
+// front-to-back within each state saves some fill on software GL
+
+static const char *state_sorted_bin = "StateSortedBin";
+static const int state_sorted_bin_number = 1;
+
+static void use_state_sorted_bin(osg::Node *node)
+{
+    if (!osgUtil::RenderBin::getRenderBinPrototype(state_sorted_bin))
+        osgUtil::RenderBin::addRenderBinPrototype(
+            state_sorted_bin, new osgUtil::RenderBin(osgUtil::RenderBin::SORT_BY_STATE_THEN_FRONT_TO_BACK));
+
+    node->getOrCreateStateSet()->setRenderBinDetails(state_sorted_bin_number, state_sorted_bin);
+}
+
 NodePtr Game::createScene()
 {
     chessboard = ChessboardPtr(new Chessboard);
@@ -175,6 +334,12 @@ NodePtr Game::createScene()
     root->setName("Root");
     root->setDataVariance(osg::Object::STATIC);
 
+    // applies published board snapshots; set before anything can nest
+    // its own update callbacks under it
+    root->setUpdateCallback(new UpdateSceneCallback(this));
+
+    animator = new Animator(root.get());
+
     osg::Matrix board_matrix;
     board_matrix.makeTranslate(0., 0., 0.);
 
@@ -203,44 +368,22 @@ NodePtr Game::createScene()
     attack_markers->setName("Board.Attack.Markers");
     attack_markers->setDataVariance(osg::Object::DYNAMIC);
     construct_attack_markers(chessboard, attack_markers);
+    use_state_sorted_bin(attack_markers.get());
+    set_marker_spin(true);
 
     root->addChild(attack_markers.get());
 
-    for (auto row : Game::one_rank)
-    {
-        for (auto col : Game::one_rank)
-        {
-            Chessboard::Cell cell = (*chessboard)(row, col);
-            if (!cell.has_piece())
-                continue;
+    pieces = new osg::Group;
+    pieces->setName("Board.Pieces");
+    pieces->setDataVariance(osg::Object::DYNAMIC);
 
-            auto position = cell.get_center();
-            auto piece = cell.get_piece();
-#if 0
-             std::cout << "[" << row << "][" << col << "] " << piece.get_name();
-
-             osg::Matrix translate_matrix;
-             translate_matrix.makeTranslate( position.x, position.y, 0.020f );
-             mt = new osg::MatrixTransform( translate_matrix );
-             mt->setDataVariance( osg::Object::DYNAMIC );
-             mt->addChild( piece.get_mesh() );
-             root->addChild( mt.get() );
-#endif
-            osg::Vec3d pos(position.x, position.y, 0.020);
-            osg::Vec3d axis(0., 0., 1.);
-            osg::Quat att(M_PI * static_cast<double>(piece.get_facing()), axis);
-
-            osg::ref_ptr<osg::PositionAttitudeTransform> patt(new osg::PositionAttitudeTransform);
-            patt->setPosition(pos);
-            patt->setAttitude(att);
-            patt->setDataVariance(osg::Object::DYNAMIC);
-            patt->addChild(piece.get_mesh());
-            patt->setName(piece.get_name());
-            patt->setUpdateCallback(new PositionPieceCallback(chessboard));
-
-            root->addChild(patt.get());
-        }
-    }
+    // the pieces are built from the first snapshot; later ones are
+    // applied during the update traversal
+    publish_snapshot();
+    update_scene();
+    use_state_sorted_bin(pieces.get());
+
+    root->addChild(pieces.get());
 
     osg::ref_ptr<osg::Light> light(new osg::Light);
     light->setAmbient(osg::Vec4(.1f, .1f, .1f, 1.f));
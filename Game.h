@@ -24,33 +24,89 @@
 // IN THE SOFTWARE.
 //------------------------------------------------------------------------------
 
+#include <atomic>
+#include <mutex>
+
 #include "OSG.h"
 #include "Chessboard.h"
+#include "Markers.h"
+#include "Animation.h"
+#include "LevelOfDetail.h"
+#include "Snapshot.h"
+
+// node masks: nodes that are drawn, and nodes that picking may intersect
+// (nodes default to both)
+const unsigned int RenderMask = 0x1;
+const unsigned int PickMask = 0x2;
 
-class Game : public osg::Referenced
+using PieceNodes = std::vector< osg::ref_ptr<osg::PositionAttitudeTransform> >;
+
+class Game : public osg::Referenced, public Chessboard::Listener
 {
     ChessboardPtr chessboard;
     NodePtr sg_root;
 
+    PieceNodes piece_nodes;     // piece id -> the transform that positions it
+
+    AnimatorPtr animator;       // drives piece moves and marker spins
+    LodBuilderPtr lod_builder;  // simplified versions of the piece and attack marker meshes
+
+    // the attack markers: only the local side's is shown, and spins while idle
+    osg::ref_ptr<osg::Switch> white_marker;
+    osg::ref_ptr<osg::Switch> black_marker;
+    osg::ref_ptr<osg::PositionAttitudeTransform> white_spinner;
+    osg::ref_ptr<osg::PositionAttitudeTransform> black_spinner;
+    Chessboard::Side marker_side{Chessboard::White};
+    bool marker_spin_enabled{false};
+
+    std::atomic<bool> frame_requested{false};
+
+    std::mutex logic_lock;
+
+    // game logic side: what to publish next
+    unsigned int layout{0};                 // bumped when the pieces are replaced
+    Chessboard::MoveMask highlighted;
+
+    // rendering side: the snapshot the scene currently shows
+    SnapshotExchange snapshots;
+    BoardSnapshotPtr applied;
+
+    // the move and capture markers, drawn over the cells set in their masks
+    InstancedMarkersPtr move_markers;
+    InstancedMarkersPtr capture_markers;
+
     GroupPtr move_squares;
     GroupPtr attack_squares;
+    GroupPtr pieces;
 
     void construct_move_squares(ChessboardPtr chessboard, GroupPtr &squares);
     void construct_capture_squares(ChessboardPtr chessboard, GroupPtr &squares);
     void construct_attack_markers(ChessboardPtr chessboard, GroupPtr &attack_group);
+    void construct_pieces(const BoardSnapshot &snapshot, GroupPtr &piece_group);
+    void publish_snapshot();
+    void show_attack_marker(Chessboard::Side side);
+    void spin_attack_marker();
     NodePtr createScene();
 
 public:
     static const std::vector<int> one_rank;     // indices for the columns in a single rank (0-7); used for looping
     static const std::vector<int> one_side;     // indices for the columns on a side (0-15); used for looping
     static const std::vector<int> white_ranks;  // indices for the ranks on the white side (0-1); used for looping
-    static const std::vector<int> center_ranks; // indices for board center (2-6); used for looping
+    static const std::vector<int> center_ranks; // indices for board center (2-5); used for looping
     static const std::vector<int> black_ranks;  // indices for the ranks on the black side (7-8); used for looping
 
     osg::Vec3 centerScope{0.0f, 0.0f, 0.0f};
 
 public:
-    Game();
+    // games drawn together (see Simul) should share one LodBuilder
+    Game(LodBuilderPtr lod_builder_ = LodBuilderPtr());
+    virtual ~Game();
+
+    // Chessboard::Listener
+    void piece_moved(const Chessboard::Piece &piece, const Chessboard::Cell &cell) override;
+    void board_reset() override;
+    void side_changed(Chessboard::Side side) override;
+    void position_changed() override;
 
     NodePtr get_root_node() const
     {
@@ -60,6 +116,53 @@ public:
     {
         return chessboard;
     }
+
+    // true while anything on the board is in motion
+    bool is_animating() const
+    {
+        return animator->is_animating();
+    }
+
+    // spin the attack markers continuously (on by default)
+    void set_marker_spin(bool spin);
+
+    // the board and highlights may be changed on threads other than the
+    // viewer's (e.g., by moves arriving over the network), so whatever
+    // reads or changes them holds this
+    std::mutex &get_lock()
+    {
+        return logic_lock;
+    }
+
+    // ask for a frame to be drawn; may be called from any thread (e.g.,
+    // when a move arrives from elsewhere)
+    void request_frame()
+    {
+        frame_requested = true;
+    }
+
+    // true if the scene has changed, or will change, and needs drawing
+    bool needs_frame();
+
+    // bring the scene up to date with the newest published snapshot;
+    // called from the update traversal
+    void update_scene();
+
+    // the snapshot the scene is showing (for use in the update traversal)
+    BoardSnapshotPtr get_snapshot() const
+    {
+        return snapshots.current();
+    }
+
+    // the initial camera view over the board
+    osg::Matrix get_home_view() const;
+
+    Chessboard::MoveMask get_highlighted() const;
+    void highlight_moves(const Chessboard::MoveMask &mask);
+    void clear_highlights()
+    {
+        highlight_moves(Chessboard::MoveMask());
+    }
 };
 
 using GamePtr = osg::ref_ptr<Game>;
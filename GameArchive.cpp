@@ -0,0 +1,375 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "GameArchive.h"
+#include "PgnPipeline.h"
+
+static const std::uint16_t archive_version = 1;
+static const std::size_t header_size = 16;
+static const std::uint32_t max_record_length = 16 << 20;
+
+// incomplete flag in a record
+static const std::uint8_t recorded_error = 1;
+
+// tags common enough to get a one-byte key (the index, plus one)
+static const char *standard_tags[] = {"Event",    "Site",     "Date",        "Round",       "White",
+                                      "Black",    "Result",   "FEN",         "SetUp",       "ECO",
+                                      "WhiteElo", "BlackElo", "TimeControl", "Termination", "PlyCount",
+                                      "Opening",  "Variation", "EventDate",  "Annotator"};
+static const std::size_t standard_tag_count = sizeof(standard_tags) / sizeof(standard_tags[0]);
+
+static const char *results[] = {"*", "1-0", "0-1", "1/2-1/2"};
+
+static bool seek(std::FILE *file, std::uint64_t offset)
+{
+#ifdef _WIN32
+    return !_fseeki64(file, static_cast<__int64>(offset), SEEK_SET);
+#else
+    return !fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+}
+
+static void put(std::vector<unsigned char> &out, std::uint64_t value, int bytes)
+{
+    for (auto i = 0; i < bytes; ++i, value >>= 8)
+        out.push_back(static_cast<unsigned char>(value & 0xff));
+}
+
+static std::uint64_t get(const unsigned char *&p, int bytes)
+{
+    std::uint64_t value = 0;
+    for (auto i = 0; i < bytes; ++i)
+        value |= std::uint64_t(p[i]) << (8 * i);
+    p += bytes;
+    return value;
+}
+
+static bool write_header(std::FILE *file, const char *magic, std::uint64_t games)
+{
+    std::vector<unsigned char> header(magic, magic + 4);
+    put(header, archive_version, 2);
+    put(header, 0, 2);
+    put(header, games, 8);
+
+    return seek(file, 0) && std::fwrite(header.data(), 1, header.size(), file) == header.size();
+}
+
+static bool read_header(std::FILE *file, const char *magic, std::uint64_t &games)
+{
+    unsigned char header[header_size];
+    if (!seek(file, 0) || std::fread(header, 1, header_size, file) != header_size || std::memcmp(header, magic, 4))
+        return false;
+
+    const unsigned char *p = header + 4;
+    if (get(p, 2) != archive_version)
+        return false;
+    p += 2;
+    games = get(p, 8);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// GameArchiveWriter
+
+GameArchiveWriter::~GameArchiveWriter()
+{
+    close();
+}
+
+bool GameArchiveWriter::create(const std::string &path)
+{
+    close();
+
+    data = std::fopen(path.c_str(), "wb");
+    index = std::fopen((path + ".idx").c_str(), "wb");
+    if (!data || !index)
+    {
+        osg::notify(osg::WARN) << "Can't create game archive '" << path << "'." << std::endl;
+        close();
+        return false;
+    }
+
+    // placeholders, until the counts are known
+    games = 0;
+    offset = header_size;
+    return write_header(data, "OCGA", 0) && write_header(index, "OCGI", 0);
+}
+
+bool GameArchiveWriter::append(const PgnGame &game)
+{
+    if (!data)
+        return false;
+
+    const auto &moves = game.get_moves();
+    auto plies = std::min<std::size_t>(moves.size(), 0xffff);
+    auto tag_count = std::min<std::size_t>(game.get_tag_count(), 0xff);
+
+    std::uint8_t result = 0;
+    for (auto i = 0u; i < 4; ++i)
+    {
+        if (!std::strcmp(game.get_result(), results[i]))
+            result = static_cast<std::uint8_t>(i);
+    }
+
+    record.clear();
+    put(record, 0, 4); // the length, filled in below
+    put(record, plies, 2);
+    put(record, result, 1);
+    put(record, (game.get_error() || plies < moves.size()) ? recorded_error : 0, 1);
+    put(record, tag_count, 1);
+
+    for (std::size_t i = 0; i < tag_count; ++i)
+    {
+        const char *name, *value;
+        std::size_t name_length, value_length;
+        game.get_tag(i, name, name_length, value, value_length);
+
+        name_length = std::min<std::size_t>(name_length, 0xff);
+        value_length = std::min<std::size_t>(value_length, 0xffff);
+
+        std::size_t key = 0;
+        while (key < standard_tag_count &&
+               !(std::strlen(standard_tags[key]) == name_length && !std::memcmp(standard_tags[key], name, name_length)))
+            ++key;
+
+        if (key < standard_tag_count)
+            put(record, key + 1, 1);
+        else
+        {
+            put(record, 0, 1);
+            put(record, name_length, 1);
+            record.insert(record.end(), name, name + name_length);
+        }
+
+        put(record, value_length, 2);
+        record.insert(record.end(), value, value + value_length);
+    }
+
+    for (std::size_t i = 0; i < plies; ++i)
+    {
+        const auto &move = moves[i];
+        put(record, move.from | (move.to << 6) | (static_cast<std::uint32_t>(move.promotion) << 12), 2);
+    }
+
+    auto length = record.size() - 4;
+    for (auto i = 0; i < 4; ++i)
+        record[i] = static_cast<unsigned char>((length >> (8 * i)) & 0xff);
+
+    unsigned char entry[8];
+    for (auto i = 0; i < 8; ++i)
+        entry[i] = static_cast<unsigned char>((offset >> (8 * i)) & 0xff);
+
+    if (std::fwrite(record.data(), 1, record.size(), data) != record.size() ||
+        std::fwrite(entry, 1, sizeof(entry), index) != sizeof(entry))
+        return false;
+
+    offset += record.size();
+    ++games;
+    return true;
+}
+
+bool GameArchiveWriter::close()
+{
+    auto written = true;
+    if (data && index)
+        written = write_header(data, "OCGA", games) && write_header(index, "OCGI", games);
+
+    if (data)
+        written = !std::fclose(data) && written;
+    if (index)
+        written = !std::fclose(index) && written;
+
+    data = nullptr;
+    index = nullptr;
+    return written;
+}
+
+//------------------------------------------------------------------------------
+// GameArchive
+
+GameArchive::~GameArchive()
+{
+    close();
+}
+
+bool GameArchive::open(const std::string &path)
+{
+    close();
+
+    data = std::fopen(path.c_str(), "rb");
+    index = std::fopen((path + ".idx").c_str(), "rb");
+
+    std::uint64_t indexed = 0;
+    if (!data || !index || !read_header(data, "OCGA", games) || !read_header(index, "OCGI", indexed) || indexed != games)
+    {
+        osg::notify(osg::WARN) << "Can't open game archive '" << path << "'." << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void GameArchive::close()
+{
+    if (data)
+        std::fclose(data);
+    if (index)
+        std::fclose(index);
+
+    data = nullptr;
+    index = nullptr;
+    games = 0;
+}
+
+bool GameArchive::read(std::uint64_t n, PgnGame &game)
+{
+    if (!data || n >= games)
+        return false;
+
+    unsigned char entry[8];
+    if (!seek(index, header_size + n * 8) || std::fread(entry, 1, sizeof(entry), index) != sizeof(entry))
+        return false;
+
+    const unsigned char *p = entry;
+    auto offset = get(p, 8);
+
+    unsigned char prefix[4];
+    if (!seek(data, offset) || std::fread(prefix, 1, sizeof(prefix), data) != sizeof(prefix))
+        return false;
+
+    p = prefix;
+    auto length = static_cast<std::uint32_t>(get(p, 4));
+    if (length < 5 || length > max_record_length)
+        return false;
+
+    record.resize(length);
+    if (std::fread(record.data(), 1, length, data) != length)
+        return false;
+
+    game.clear();
+    game.offset = offset;
+
+    p = record.data();
+    auto end = p + length;
+
+    auto plies = static_cast<std::size_t>(get(p, 2));
+    auto result = get(p, 1);
+    auto flags = get(p, 1);
+    auto tag_count = get(p, 1);
+
+    game.result = results[result < 4 ? result : 0];
+    if (flags & recorded_error)
+        game.error = "recorded with an error";
+
+    for (std::uint64_t i = 0; i < tag_count; ++i)
+    {
+        PgnGame::Tag tag;
+        tag.name = static_cast<std::uint32_t>(game.text.size());
+
+        if (p >= end)
+            return false;
+        auto key = get(p, 1);
+        if (key)
+        {
+            if (key > standard_tag_count)
+                return false;
+            auto name = standard_tags[key - 1];
+            game.text.insert(game.text.end(), name, name + std::strlen(name));
+        }
+        else
+        {
+            if (p >= end)
+                return false;
+            auto name_length = get(p, 1);
+            if (end - p < static_cast<std::ptrdiff_t>(name_length))
+                return false;
+            game.text.insert(game.text.end(), p, p + name_length);
+            p += name_length;
+        }
+        tag.name_length = static_cast<std::uint32_t>(game.text.size() - tag.name);
+
+        if (end - p < 2)
+            return false;
+        auto value_length = get(p, 2);
+        if (end - p < static_cast<std::ptrdiff_t>(value_length))
+            return false;
+
+        tag.value = static_cast<std::uint32_t>(game.text.size());
+        tag.value_length = static_cast<std::uint32_t>(value_length);
+        game.text.insert(game.text.end(), p, p + value_length);
+        p += value_length;
+
+        game.tags.push_back(tag);
+    }
+
+    if (end - p != static_cast<std::ptrdiff_t>(plies * 2))
+        return false;
+
+    game.moves.resize(plies);
+    for (auto &move : game.moves)
+    {
+        auto packed = get(p, 2);
+        move.from = static_cast<std::uint8_t>(packed & 63);
+        move.to = static_cast<std::uint8_t>((packed >> 6) & 63);
+        move.promotion = static_cast<Chessboard::Piece::Rank>((packed >> 12) & 7);
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+int convert_pgn(const std::string &pgn_file, const std::string &archive_file, unsigned int workers)
+{
+    GameArchiveWriter writer;
+    if (!writer.create(archive_file))
+        return 1;
+
+    // in file order, so that game n of the archive is game n of the PGN
+    PgnPipeline pipeline(workers, true);
+    PgnPipeline::Report report;
+
+    auto written = true;
+    if (!pipeline.run(pgn_file, [&](const PgnGame &game) { return written = writer.append(game); }, report))
+        return 1;
+
+    if (!writer.close() || !written)
+    {
+        osg::notify(osg::WARN) << "Failed writing game archive '" << archive_file << "'." << std::endl;
+        return 1;
+    }
+
+    std::cout << report.games << " games (" << report.bad_games << " with errors) in " << std::fixed
+              << std::setprecision(2) << report.seconds << " s; " << (report.bytes / (1024. * 1024.)) << " MB of PGN became "
+              << (writer.get_bytes() / (1024. * 1024.)) << " MB, plus a " << ((16 + report.games * 8) / 1024.)
+              << " KB index" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Pgn.h"
+
+// GameArchive -- games stored in a compact binary form, with an index so
+// that any one of them can be read without touching the others.  All the
+// integers are little-endian.
+//
+// The archive file is a 16-byte header ("OCGA", a u16 version, two spare
+// bytes and a u64 game count), then a record per game:
+//
+//     u32  length of the rest of the record
+//     u16  plies
+//     u8   result (0 "*", 1 "1-0", 2 "0-1", 3 "1/2-1/2")
+//     u8   flags (1: the moves stop at an error)
+//     u8   tag count
+//     per tag: u8 key (a standard tag, or 0 and then a u8 name length and
+//              the name), u16 value length, the value
+//     per ply: u16 from | to << 6 | promotion << 12 (cells as PgnMove,
+//              promotion as a Piece::Rank)
+//
+// The index file (the archive's name plus ".idx") is a header of the same
+// shape ("OCGI"), then the u64 offset of each game's record.
+
+class GameArchiveWriter
+{
+public:
+    ~GameArchiveWriter();
+
+    bool create(const std::string &path);
+    bool append(const PgnGame &game);
+
+    // writes the game counts; the archive isn't readable until it's closed
+    bool close();
+
+    std::uint64_t get_games() const
+    {
+        return games;
+    }
+    std::uint64_t get_bytes() const
+    {
+        return offset;
+    }
+
+protected:
+    std::FILE *data{nullptr};
+    std::FILE *index{nullptr};
+    std::vector<unsigned char> record;
+    std::uint64_t offset{0};
+    std::uint64_t games{0};
+};
+
+class GameArchive
+{
+public:
+    ~GameArchive();
+
+    bool open(const std::string &path);
+    void close();
+
+    std::uint64_t size() const
+    {
+        return games;
+    }
+
+    // read game n (counting from 0): one index entry, and its record.
+    // An archive is read on one thread at a time.
+    bool read(std::uint64_t n, PgnGame &game);
+
+protected:
+    std::FILE *data{nullptr};
+    std::FILE *index{nullptr};
+    std::vector<unsigned char> record;
+    std::uint64_t games{0};
+};
+
+// convert a PGN file into an archive (and its index), reading it through a
+// PgnPipeline with the given number of workers (0 for one per core)
+int convert_pgn(const std::string &pgn_file, const std::string &archive_file, unsigned int workers);
@@ -0,0 +1,113 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include "GameHistory.h"
+
+GameHistory::GameHistory(ChessboardPtr board_, unsigned int interval_) :
+    board(board_), interval(interval_ ? interval_ : 1)
+{
+    restart();
+    board->add_listener(this);
+}
+
+GameHistory::~GameHistory()
+{
+    board->remove_listener(this);
+}
+
+void GameHistory::restart()
+{
+    moves.clear();
+    ply = 0;
+
+    states.resize(1);
+    board->get_state(states[0]);
+}
+
+void GameHistory::board_reset()
+{
+    // the pieces (and their ids) are new; nothing before applies
+    restart();
+}
+
+void GameHistory::move_made(int from_row, int from_col, int to_row, int to_col, Chessboard::Piece::Rank promotion)
+{
+    // a move made from an earlier ply starts a new line
+    moves.resize(ply);
+    states.resize(ply / interval + 1);
+
+    PgnMove move;
+    move.from = static_cast<std::uint8_t>(from_row * 8 + from_col);
+    move.to = static_cast<std::uint8_t>(to_row * 8 + to_col);
+    move.promotion = promotion;
+    moves.push_back(move);
+
+    if (++ply % interval == 0)
+    {
+        states.emplace_back();
+        board->get_state(states.back());
+    }
+}
+
+bool GameHistory::seek(std::size_t target)
+{
+    if (target > moves.size())
+        return false;
+    if (target == ply)
+        return true;
+
+    // go on from here if that's no further than from the nearest state
+    auto from = target - target % interval;
+    if (target > ply && ply >= from)
+        from = ply;
+
+    board->hold_notifications();
+
+    if (from != ply)
+        board->set_state(states[from / interval]);
+
+    auto replayed = true;
+    for (auto i = from; i < target && replayed; ++i)
+    {
+        const auto &move = moves[i];
+        board->select((*board)(move.from / 8, move.from % 8));
+        replayed = board->move_selected_to(move.to / 8, move.to % 8, move.promotion);
+    }
+
+    // (the moves were all made once already, so they can't fail unless the
+    // board has been changed behind our back)
+    if (!replayed)
+    {
+        osg::notify(osg::WARN) << "Couldn't replay the game history to ply " << target << "." << std::endl;
+        board->release_notifications();
+        restart();
+        return false;
+    }
+
+    ply = target;
+    board->clear_selection();
+    board->release_notifications();
+
+    return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstddef>
+#include <vector>
+
+#include "OSG.h"
+#include "Chessboard.h"
+#include "Pgn.h"
+
+// GameHistory -- records every move made on a board, so they can be taken
+// back and made again, and the board sent to any ply.  Every interval
+// plies the whole board state is kept too, so going to a ply replays at
+// most interval - 1 moves from the nearest state before it, however long
+// the game.  A jump is made with the board's notifications held, so the
+// scene sees one change, whatever it took to get there.  Making a move
+// anywhere but at the end of the history drops the moves after it; a
+// board reset starts the history over from the new position.
+
+class GameHistory : public osg::Referenced, public Chessboard::Listener
+{
+public:
+    GameHistory(ChessboardPtr board_, unsigned int interval_ = 16);
+    ~GameHistory() override;
+
+    // Chessboard::Listener
+    void piece_moved(const Chessboard::Piece &, const Chessboard::Cell &) override {}
+    void board_reset() override;
+    void side_changed(Chessboard::Side) override {}
+    void position_changed() override {}
+    void move_made(int from_row, int from_col, int to_row, int to_col, Chessboard::Piece::Rank promotion) override;
+
+    // the moves recorded, and how many of them the board shows
+    const std::vector<PgnMove> &get_moves() const
+    {
+        return moves;
+    }
+    std::size_t size() const
+    {
+        return moves.size();
+    }
+    std::size_t get_ply() const
+    {
+        return ply;
+    }
+
+    bool undo()
+    {
+        return ply > 0 && seek(ply - 1);
+    }
+    bool redo()
+    {
+        return seek(ply + 1);
+    }
+
+    // put the board as it was after the given number of plies
+    bool seek(std::size_t target);
+
+    // forget everything, and start over from the board as it stands
+    void restart();
+
+protected:
+    ChessboardPtr board;
+    unsigned int interval;
+
+    std::vector<PgnMove> moves;
+    std::size_t ply{0};
+
+    // states[i] is the board after i * interval plies
+    std::vector<Chessboard::State> states;
+};
+
+using GameHistoryPtr = osg::ref_ptr<GameHistory>;
@@ -0,0 +1,508 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "GameServer.h"
+#include "LittleEndian.h"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// replies waiting to go out to a connection, past which it isn't read
+// from until they've been sent
+static const std::size_t outgoing_limit = 65536;
+
+BoardPool::BoardPool(std::size_t capacity) : slots(capacity)
+{
+    free_slots.reserve(capacity);
+    for (auto slot = capacity; slot-- > 0;)
+        free_slots.push_back(static_cast<int>(slot));
+}
+
+int BoardPool::acquire(std::uint32_t owner)
+{
+    if (free_slots.empty())
+        return -1;
+
+    auto slot = free_slots.back();
+    free_slots.pop_back();
+
+    Rules::start(slots[slot].board);
+    slots[slot].owner = owner;
+    return slot;
+}
+
+void BoardPool::release(int slot)
+{
+    slots[slot].owner = 0;
+    free_slots.push_back(slot);
+}
+
+Rules::Board *BoardPool::find(std::uint32_t slot, std::uint32_t owner)
+{
+    if (slot >= slots.size() || slots[slot].owner != owner)
+        return nullptr;
+    return &slots[slot].board;
+}
+
+GameServer::GameServer(std::size_t boards, int workers_)
+{
+    if (workers_ <= 0)
+        workers_ = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    auto share = (boards + workers_ - 1) / workers_;
+    for (auto index = 0; index < workers_; ++index)
+        workers.emplace_back(new Worker(share));
+}
+
+GameServer::~GameServer()
+{
+    stop();
+}
+
+bool GameServer::start(const std::string &path_)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path_.empty() || path_.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "'" << path_ << "' can't name a local socket." << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, path_.c_str(), path_.size());
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+    {
+        std::cerr << "Can't create a socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    unlink(path_.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) || ::listen(listener, SOMAXCONN))
+    {
+        std::cerr << "Can't listen at '" << path_ << "': " << std::strerror(errno) << std::endl;
+        close(listener);
+        listener = -1;
+        return false;
+    }
+    path = path_;
+
+    for (auto &worker : workers)
+    {
+        worker->events = epoll_create1(EPOLL_CLOEXEC);
+        worker->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (worker->events < 0 || worker->wake < 0)
+        {
+            std::cerr << "Can't create the event loops: " << std::strerror(errno) << std::endl;
+            stop();
+            return false;
+        }
+
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = worker->wake;
+        epoll_ctl(worker->events, EPOLL_CTL_ADD, worker->wake, &event);
+    }
+
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(workers.front()->events, EPOLL_CTL_ADD, listener, &event);
+
+    for (auto &worker : workers)
+    {
+        auto running = worker.get();
+        worker->thread = std::thread([this, running] { run(*running); });
+    }
+
+    return true;
+}
+
+void GameServer::stop()
+{
+    stopping = true;
+
+    for (auto &worker : workers)
+    {
+        if (worker->wake >= 0)
+        {
+            std::uint64_t one = 1;
+            if (write(worker->wake, &one, sizeof(one)) < 0)
+                std::cerr << "Can't wake a worker: " << std::strerror(errno) << std::endl;
+        }
+        if (worker->thread.joinable())
+            worker->thread.join();
+
+        for (auto &entry : worker->connections)
+            close(entry.first);
+        worker->connections.clear();
+
+        std::lock_guard<std::mutex> guard(worker->arrivals_lock);
+        for (auto socket : worker->arrivals)
+            close(socket);
+        worker->arrivals.clear();
+
+        if (worker->events >= 0)
+            close(worker->events);
+        if (worker->wake >= 0)
+            close(worker->wake);
+        worker->events = worker->wake = -1;
+    }
+
+    if (listener >= 0)
+    {
+        close(listener);
+        unlink(path.c_str());
+        listener = -1;
+    }
+}
+
+std::uint64_t GameServer::get_moves() const
+{
+    std::uint64_t moves = 0;
+    for (const auto &worker : workers)
+        moves += worker->moves;
+    return moves;
+}
+
+std::uint64_t GameServer::get_games() const
+{
+    std::uint64_t games = 0;
+    for (const auto &worker : workers)
+        games += worker->games;
+    return games;
+}
+
+std::size_t GameServer::get_connections() const
+{
+    std::size_t open = 0;
+    for (const auto &worker : workers)
+        open += worker->open;
+    return open;
+}
+
+void GameServer::run(Worker &worker)
+{
+    epoll_event ready[64];
+
+    while (!stopping)
+    {
+        auto count = epoll_wait(worker.events, ready, 64, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "The event loop failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        for (auto index = 0; index < count && !stopping; ++index)
+        {
+            auto socket = ready[index].data.fd;
+            auto events = ready[index].events;
+
+            if (socket == worker.wake)
+            {
+                std::uint64_t value;
+                if (read(worker.wake, &value, sizeof(value)) < 0 && errno != EAGAIN)
+                    std::cerr << "Can't read a worker's wake: " << std::strerror(errno) << std::endl;
+                take_arrivals(worker);
+                continue;
+            }
+
+            if (socket == listener)
+            {
+                accept_connections();
+                continue;
+            }
+
+            auto found = worker.connections.find(socket);
+            if (found == worker.connections.end())
+                continue;
+            Connection &connection = *found->second;
+
+            // (a connection that isn't being read from is only closed on
+            // a hang-up, since its replies can't go anywhere)
+            auto alive = true;
+            if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                alive = connection.reading ? receive(worker, connection) : !(events & (EPOLLHUP | EPOLLERR));
+            if (alive && (events & EPOLLOUT))
+                alive = flush(worker, connection);
+            if (!alive)
+                close_connection(worker, connection);
+        }
+    }
+}
+
+void GameServer::accept_connections()
+{
+    for (;;)
+    {
+        auto socket = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                std::cerr << "Can't accept a connection: " << std::strerror(errno) << std::endl;
+            return;
+        }
+
+        Worker &worker = *workers[next_worker++ % workers.size()];
+        {
+            std::lock_guard<std::mutex> guard(worker.arrivals_lock);
+            worker.arrivals.push_back(socket);
+        }
+
+        std::uint64_t one = 1;
+        if (write(worker.wake, &one, sizeof(one)) < 0)
+            std::cerr << "Can't wake a worker: " << std::strerror(errno) << std::endl;
+    }
+}
+
+void GameServer::take_arrivals(Worker &worker)
+{
+    std::vector<int> arrived;
+    {
+        std::lock_guard<std::mutex> guard(worker.arrivals_lock);
+        arrived.swap(worker.arrivals);
+    }
+
+    for (auto socket : arrived)
+    {
+        std::unique_ptr<Connection> connection(new Connection);
+        connection->socket = socket;
+        connection->id = worker.next_id++;
+        if (!worker.next_id)
+            worker.next_id = 1;
+
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = socket;
+        if (epoll_ctl(worker.events, EPOLL_CTL_ADD, socket, &event))
+        {
+            std::cerr << "Can't watch a connection: " << std::strerror(errno) << std::endl;
+            close(socket);
+            continue;
+        }
+
+        worker.connections[socket] = std::move(connection);
+        ++worker.open;
+    }
+}
+
+void GameServer::close_connection(Worker &worker, Connection &connection)
+{
+    for (auto game : connection.games)
+        worker.pool.release(game);
+
+    auto socket = connection.socket;
+    epoll_ctl(worker.events, EPOLL_CTL_DEL, socket, nullptr);
+    close(socket);
+
+    worker.connections.erase(socket);
+    --worker.open;
+}
+
+// read what's arrived, answer every whole frame in it, and send the
+// answers back together; false if the connection is done
+
+bool GameServer::receive(Worker &worker, Connection &connection)
+{
+    unsigned char buffer[16384];
+
+    auto received = recv(connection.socket, buffer, sizeof(buffer), 0);
+    if (received == 0)
+        return false;
+    if (received < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    const unsigned char *next = buffer;
+    const unsigned char *end = buffer + received;
+
+    if (connection.partial_length)
+    {
+        auto needed = std::min<std::size_t>(frame_size - connection.partial_length, end - next);
+        std::memcpy(connection.partial + connection.partial_length, next, needed);
+        connection.partial_length += needed;
+        next += needed;
+
+        if (connection.partial_length < frame_size)
+            return true;
+
+        request(worker, connection, connection.partial);
+        connection.partial_length = 0;
+    }
+
+    for (; end - next >= static_cast<std::ptrdiff_t>(frame_size); next += frame_size)
+        request(worker, connection, next);
+
+    connection.partial_length = end - next;
+    std::memcpy(connection.partial, next, connection.partial_length);
+
+    return flush(worker, connection);
+}
+
+void GameServer::request(Worker &worker, Connection &connection, const unsigned char *frame)
+{
+    auto game = static_cast<std::uint32_t>(read_le(frame + 4, 4));
+
+    switch (frame[0])
+    {
+        case 'N':
+        {
+            auto slot = worker.pool.acquire(connection.id);
+            if (slot < 0)
+            {
+                reply(connection, 'E', 0, 0);
+                break;
+            }
+
+            connection.games.push_back(slot);
+            ++worker.games;
+            reply(connection, 'G', 0, static_cast<std::uint32_t>(slot));
+            break;
+        }
+
+        case 'M':
+        {
+            auto board = worker.pool.find(game, connection.id);
+            if (!board)
+            {
+                reply(connection, 'R', NoSuchGame, game);
+                break;
+            }
+
+            int from = frame[1];
+            int to = frame[2];
+            if (from > 63 || to > 63)
+            {
+                reply(connection, 'R', BadRequest, game);
+                break;
+            }
+
+            if (Rules::side_at(*board, from / 8, from % 8) != board->to_move ||
+                !Rules::is_legal(*board, from / 8, from % 8, to / 8, to % 8))
+            {
+                reply(connection, 'R', IllegalMove, game);
+                break;
+            }
+
+            Rules::make_move(*board, from / 8, from % 8, to / 8, to % 8, frame[3]);
+            ++worker.moves;
+
+            auto check = Rules::in_check(*board, board->to_move);
+            auto result = check ? Check : Played;
+            if (!Rules::can_move(*board))
+                result = check ? Checkmate : Stalemate;
+
+            reply(connection, 'A', result, game);
+            break;
+        }
+
+        case 'Q':
+        {
+            if (!worker.pool.find(game, connection.id))
+                break;
+
+            worker.pool.release(static_cast<int>(game));
+            for (auto &held : connection.games)
+            {
+                if (held == static_cast<int>(game))
+                {
+                    held = connection.games.back();
+                    connection.games.pop_back();
+                    break;
+                }
+            }
+            break;
+        }
+
+        default:
+            reply(connection, 'R', BadRequest, game);
+            break;
+    }
+}
+
+void GameServer::reply(Connection &connection, char type, int code, std::uint32_t value)
+{
+    unsigned char frame[frame_size] = {static_cast<unsigned char>(type), static_cast<unsigned char>(code)};
+    write_le(frame + 4, value, 4);
+    connection.outgoing.insert(connection.outgoing.end(), frame, frame + frame_size);
+}
+
+// send what's waiting, and watch for room to send the rest (if any),
+// holding off reading while too much is left; false if the connection has
+// failed
+
+bool GameServer::flush(Worker &worker, Connection &connection)
+{
+    std::size_t sent = 0;
+    while (sent < connection.outgoing.size())
+    {
+        auto result = send(connection.socket, connection.outgoing.data() + sent, connection.outgoing.size() - sent,
+                           MSG_NOSIGNAL);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        sent += result;
+    }
+    connection.outgoing.erase(connection.outgoing.begin(), connection.outgoing.begin() + sent);
+
+    auto waiting = !connection.outgoing.empty();
+    auto reading = connection.outgoing.size() < outgoing_limit;
+    if (waiting != connection.waiting_to_send || reading != connection.reading)
+    {
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        if (reading)
+            event.events |= EPOLLIN;
+        if (waiting)
+            event.events |= EPOLLOUT;
+        event.data.fd = connection.socket;
+        epoll_ctl(worker.events, EPOLL_CTL_MOD, connection.socket, &event);
+        connection.waiting_to_send = waiting;
+        connection.reading = reading;
+    }
+
+    return true;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Rules.h"
+
+// BoardPool -- the boards of the games in play, side by side in a vector
+// sized once up front (76 bytes a game, so a hundred thousand take under
+// 8 MB).  Freed slots go on a stack and are handed out again first, so
+// the games in play stay packed toward the front.
+
+class BoardPool
+{
+public:
+    explicit BoardPool(std::size_t capacity);
+
+    // a slot holding the opening position, or -1 if the pool is full
+    int acquire(std::uint32_t owner);
+    void release(int slot);
+
+    // the board in a slot, if the owner holds it (otherwise nullptr)
+    Rules::Board *find(std::uint32_t slot, std::uint32_t owner);
+
+    std::size_t in_use() const
+    {
+        return slots.size() - free_slots.size();
+    }
+
+protected:
+    struct Slot
+    {
+        Rules::Board board;
+        std::uint32_t owner{0};     // the connection playing it; 0 if free
+    };
+
+    std::vector<Slot> slots;
+    std::vector<int> free_slots;
+};
+
+// GameServer -- referees games for clients on a local (Unix domain)
+// socket, with no board drawn and nothing of OSG linked in.  Each worker
+// thread runs its own epoll loop over its own connections and its own
+// BoardPool, so they share nothing but the listening socket, and adding
+// cores adds games.  The first worker accepts connections and deals them
+// out to the workers in turn.
+//
+// Messages are 8-byte frames, and replies come back in the order their
+// requests were sent:
+//
+//   'N', 0, 0, 0, u32 0                start a game; the reply is
+//   'G', 0, 0, 0, u32 game               its number, or
+//   'E', 0, 0, 0, u32 0                  an error if every board is in use
+//   'M', from, to, promotion, u32 game make a move (cells are row * 8 + col,
+//                                      and promotion is a Rules::Rank); the
+//                                      reply is
+//   'A', result, 0, 0, u32 game          the move was made (see Result), or
+//   'R', reason, 0, 0, u32 game          it was refused (see Refusal)
+//   'Q', 0, 0, 0, u32 game             end a game (there is no reply)
+//
+// A connection's games end with it, and game numbers mean nothing on any
+// other connection.  A client that stops reading its replies is no longer
+// read from either, until they've gone out.
+
+class GameServer
+{
+public:
+    enum Result : std::uint8_t
+    {
+        Played,
+        Check,
+        Checkmate,
+        Stalemate
+    };
+
+    enum Refusal : std::uint8_t
+    {
+        NoSuchGame = 1,
+        IllegalMove,
+        BadRequest
+    };
+
+    static const std::size_t frame_size = 8;
+
+    // boards are divided evenly among the workers (0 workers: one per core)
+    GameServer(std::size_t boards, int workers = 0);
+    ~GameServer();
+
+    // start serving on a socket at path (replacing any left there by a
+    // server that didn't shut down); false if it can't
+    bool start(const std::string &path);
+
+    // stop the workers and close every connection
+    void stop();
+
+    // moves made and games started so far, on all workers
+    std::uint64_t get_moves() const;
+    std::uint64_t get_games() const;
+    std::size_t get_connections() const;
+
+protected:
+    struct Connection
+    {
+        int socket{-1};
+        std::uint32_t id{0};
+        unsigned char partial[frame_size];
+        std::size_t partial_length{0};
+        std::vector<unsigned char> outgoing;
+        bool waiting_to_send{false};    // watching for room to send the rest
+        bool reading{true};             // false while too many replies wait to go out
+        std::vector<int> games;
+    };
+
+    struct Worker
+    {
+        Worker(std::size_t boards) : pool(boards) {}
+
+        int events{-1};     // the epoll descriptor
+        int wake{-1};       // an eventfd, for new connections and stopping
+        BoardPool pool;
+        std::unordered_map<int, std::unique_ptr<Connection>> connections;
+        std::uint32_t next_id{1};
+
+        // sockets accepted for this worker, not yet taken up
+        std::mutex arrivals_lock;
+        std::vector<int> arrivals;
+
+        std::atomic<std::uint64_t> moves{0};
+        std::atomic<std::uint64_t> games{0};
+        std::atomic<std::size_t> open{0};
+
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::string path;
+    int listener{-1};
+    std::atomic<bool> stopping{false};
+    std::size_t next_worker{0};
+
+    void run(Worker &worker);
+    void accept_connections();
+    void take_arrivals(Worker &worker);
+    void close_connection(Worker &worker, Connection &connection);
+
+    bool receive(Worker &worker, Connection &connection);
+    void request(Worker &worker, Connection &connection, const unsigned char *frame);
+    void reply(Connection &connection, char type, int code, std::uint32_t value);
+    bool flush(Worker &worker, Connection &connection);
+};
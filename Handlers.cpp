@@ -22,9 +22,30 @@
 // IN THE SOFTWARE.
 //------------------------------------------------------------------------------
 
+#include <iomanip>
+#include <iostream>
+
 #include "Chessboard.h"
 #include "Handlers.h"
-#include "Visitors.h"
+#include "Profiler.h"
+#include "NodeTags.h"
+
+// height of the board's playing surface, where pieces stand
+static const double board_surface = 0.02;
+
+// a little taller than the tallest piece (the King)
+static const double tallest_piece = 0.09;
+
+// a move in coordinate form, e.g. "e2e4", or "e7e8=q" for a promotion
+
+static void write_move(std::ostream &out, const PgnMove &move)
+{
+    static const char promotions[] = " rnbkqp";
+
+    out << char('a' + move.from % 8) << char('1' + move.from / 8) << char('a' + move.to % 8) << char('1' + move.to / 8);
+    if (move.promotion != Chessboard::Piece::Rank::Empty)
+        out << '=' << promotions[static_cast<int>(move.promotion)];
+}
 
 PickHandlerInterface::PickHandlerInterface() {}
 
@@ -55,7 +76,10 @@ bool PickHandlerInterface::handle(const osgGA::GUIEventAdapter &ea, osgGA::GUIAc
                 if (x_eq && y_eq)
                 {
                     if (pick(static_cast<double>(ea.getXnormalized()), static_cast<double>(ea.getYnormalized()), viewer))
+                    {
+                        aa.requestRedraw();
                         return true;
+                    }
                 }
             }
             return false;
@@ -73,13 +97,27 @@ bool PickHandlerInterface::pick(const double x, const double y, osgViewer::Viewe
     if (!viewer->getSceneData())
         return false; // nothing to pick
 
-    auto w(.005), h(.005);
-    auto picker = new osgUtil::PolytopeIntersector(osgUtil::Intersector::PROJECTION, x - w, y - h, x + w, y + h);
-    osgUtil::IntersectionVisitor iv(picker);
-    viewer->getCamera()->accept(iv);
+    ProfileScope scope(Profiler::Picking);
+
+    osg::Vec3d near_point, far_point;
+    if (compute_ray(x, y, viewer, near_point, far_point))
+    {
+        switch (process_ray(near_point, far_point))
+        {
+            case RayResult::Picked:
+                return true;
+            case RayResult::Missed:
+                return false;
+            case RayResult::Ambiguous:
+                break;
+        }
+    }
+
+    // fall back to intersecting the meshes in the scene
 
-    if (picker->containsIntersections())
-        return process_pick(picker->getFirstIntersection().nodePath);
+    osg::NodePath nodePath;
+    if (intersect_meshes(x, y, viewer->getCamera(), nodePath))
+        return process_pick(nodePath);
     else if (_selectedNode.valid())
     {
         _selectedNode->setUpdateCallback(nullptr);
@@ -89,106 +127,295 @@ bool PickHandlerInterface::pick(const double x, const double y, osgViewer::Viewe
     return _selectedNode.valid();
 }
 
-SelectionHandler::SelectionHandler(ChessboardPtr board_, NodePtr sg_root_) :
-    PickHandlerInterface(), board(board_), sg_root(sg_root_)
+bool PickHandlerInterface::intersect_meshes(const double x, const double y, osg::Camera *camera, osg::NodePath &nodePath) const
+{
+    ProfileScope scope(Profiler::MeshIntersection);
+
+    if (pick_mode == PickMode::Polytope)
+    {
+        auto w(.005), h(.005);
+        osg::ref_ptr<osgUtil::PolytopeIntersector> picker(
+            new osgUtil::PolytopeIntersector(osgUtil::Intersector::PROJECTION, x - w, y - h, x + w, y + h));
+        osgUtil::IntersectionVisitor iv(picker.get());
+        iv.setTraversalMask(PickMask);
+        camera->accept(iv);
+
+        if (!picker->containsIntersections())
+            return false;
+
+        nodePath = picker->getFirstIntersection().nodePath;
+        return true;
+    }
+
+    osg::ref_ptr<osgUtil::LineSegmentIntersector> picker(
+        new osgUtil::LineSegmentIntersector(osgUtil::Intersector::PROJECTION, x, y));
+    picker->setIntersectionLimit(osgUtil::Intersector::LIMIT_NEAREST);
+
+    osgUtil::IntersectionVisitor iv(picker.get());
+    iv.setTraversalMask(PickMask);
+    iv.setUseKdTreeWhenAvailable(pick_mode == PickMode::KdTreeRay);
+    camera->accept(iv);
+
+    if (!picker->containsIntersections())
+        return false;
+
+    nodePath = picker->getFirstIntersection().nodePath;
+    return true;
+}
+
+bool PickHandlerInterface::compute_ray(const double x, const double y, osgViewer::Viewer *viewer,
+                                       osg::Vec3d &near_point, osg::Vec3d &far_point)
+{
+    auto camera = viewer->getCamera();
+
+    osg::Matrixd inverse_vp;
+    if (!inverse_vp.invert(camera->getViewMatrix() * camera->getProjectionMatrix()))
+        return false;
+
+    // unproject the mouse position at the near and far clip planes
+    near_point = osg::Vec3d(x, y, -1.) * inverse_vp;
+    far_point = osg::Vec3d(x, y, 1.) * inverse_vp;
+
+    return true;
+}
+
+SelectionHandler::SelectionHandler(GamePtr game_) :
+    PickHandlerInterface(), game(game_), board(game_->get_board())
 {}
 
-bool SelectionHandler::process_pick(const osg::NodePath &nodePath)
+// a board cell was clicked: either move the selected piece there (if it
+// is one of the highlighted targets), or select the local side's piece
+// that stands on it
+
+bool SelectionHandler::select_cell(int row, int col)
 {
+    auto targets = game->get_highlighted();
+
     // clear any existing visible markers
-    TurnOffMoveHighlights off_visitor;
-    sg_root->accept(off_visitor);
+    game->clear_highlights();
 
-    std::string node_id;
-    auto tail = nodePath.size();
-    while (tail--)
-    {
-        // find the first PositionAttitudeTransform in the
-        // node path; this will be the node that identifies
+    // (highlights with nothing selected aren't targets; e.g., they show
+    // the other player's last move)
+    int selected_row, selected_col;
+    std::tie(selected_row, selected_col) = board->get_selected();
 
-        auto patt = dynamic_cast<osg::PositionAttitudeTransform *>(nodePath[tail]);
-        if (patt == nullptr)
-            continue;
+    if (selected_row >= 0 && ((targets.moves | targets.captures) & Chessboard::cell_bit(row, col)))
+        return board->move_selected_to(row, col);
 
-        node_id = nodePath[tail]->getName();
-        break;
-    }
+    auto &cell = (*board)(row, col);
+    if (!cell.has_piece())
+        return false;
 
-    if (node_id.size())
-    {
-        tail = nodePath.size() - 1;
-        auto node = dynamic_cast<osg::Node *>(nodePath[tail]);
-        if (node == nullptr)
-            return false;
+    if (cell.piece.get_side() != board->local_side() || !(cell.piece.get_side() & player_sides))
+        return false; // trying to select opponent's piece
 
-        // is it a chess piece?
+    board->clear_selection();
+    board->select(cell);
 
-        if (board->is_piece(node_id))
-        {
-            auto cell = board->find_piece(node_id);
-            if (cell.type != Chessboard::Cell::Type::Board)
-                return false; // they're trying to select a captured piece
+    game->highlight_moves(board->legal_moves(cell));
 
-            auto piece = cell.get_piece();
-            if (piece.get_side() != board->local_side())
-                return false; // trying to select opponent's piece
+    return true;
+}
 
-            board->clear_selection();
-            board->select(cell);
+PickHandlerInterface::RayResult SelectionHandler::process_ray(const osg::Vec3d &near_point, const osg::Vec3d &far_point)
+{
+    std::lock_guard<std::mutex> guard(game->get_lock());
 
-            // enable these
+    surface_cell = Position(-1, -1);
 
-            auto paths = board->valid_paths(cell);
-            if (paths.size())
-            {
-                TurnOnMoveHighlights on_visitor(paths);
-                sg_root->accept(on_visitor);
-            }
+    auto direction = far_point - near_point;
+    if (compare_f(direction.z(), 0., 1e-9))
+        return RayResult::Ambiguous; // looking along the board
+
+    auto at_height = [&](double z) {
+        return near_point + direction * ((z - near_point.z()) / direction.z());
+    };
+
+    // where does the ray meet the playing surface?
+
+    auto surface = at_height(board_surface);
 
+    int row, col;
+    auto on_board = board->cell_at(surface.x(), surface.y(), row, col);
+
+    // a piece standing in a neighboring cell may be in front of that
+    // point.  follow the ray up to the height of the tallest piece, cell
+    // by cell; if it passes over any other occupied cell, only the meshes
+    // can tell us what was actually clicked.
+
+    auto top = at_height(board_surface + tallest_piece);
+    auto blocked = false;
+    board->for_each_cell_along(surface.x(), surface.y(), top.x(), top.y(), [&](int r, int c) {
+        if (on_board && r == row && c == col)
             return true;
+        blocked = (*board)(r, c).has_piece();
+        return !blocked;
+    });
+
+    if (blocked)
+    {
+        // if the meshes show no piece was hit, it's this cell
+        surface_cell = on_board ? Position(row, col) : Position(-1, -1);
+        return RayResult::Ambiguous;
+    }
+
+    if (!on_board)
+        return RayResult::Missed;
+
+    return select_cell(row, col) ? RayResult::Picked : RayResult::Missed;
+}
+
+bool SelectionHandler::process_pick(const osg::NodePath &nodePath)
+{
+    std::lock_guard<std::mutex> guard(game->get_lock());
+
+    // find the nearest tagged node in the node path; this will be the
+    // node that identifies what was hit
+
+    const NodeTag *tag = nullptr;
+    for (auto tail = nodePath.size(); tail-- && !tag;)
+        tag = NodeTag::get(nodePath[tail]);
+
+    if (tag)
+    {
+        // is it a chess piece?
+
+        if (tag->kind == NodeTag::Kind::Piece)
+        {
+            auto cell = board->find_piece(tag->index);
+            if (cell && cell->type == Chessboard::Cell::Type::Board)
+                return select_cell(cell->row, cell->col);
+
+            // otherwise, they're trying to select a captured piece
         }
 
+        game->clear_highlights();
         return false;
     }
 
-    // is it a marker?
+    // no piece was hit; if the ray met the board, it's the cell under it
 
-    node_id.clear();
-    tail = nodePath.size();
-    while (tail--)
-    {
-        // find the first PositionAttitudeTransform in the
-        // node path; this will be the node that identifies
+    int row, col;
+    std::tie(row, col) = surface_cell;
 
-        auto switch_node = dynamic_cast<osg::Switch *>(nodePath[tail]);
-        if (switch_node == nullptr)
-            continue;
+    if (row >= 0 && col >= 0)
+        return select_cell(row, col);
 
-        node_id = nodePath[tail]->getName();
-        break;
+    game->clear_highlights();
+    return false;
+}
+
+PositionQueryHandler::PositionQueryHandler(GamePtr game_, std::shared_ptr<const PositionIndex> index_) :
+    game(game_), index(index_)
+{}
+
+bool PositionQueryHandler::handle(const osgGA::GUIEventAdapter &ea, osgGA::GUIActionAdapter & /*aa*/)
+{
+    if (ea.getEventType() != osgGA::GUIEventAdapter::KEYDOWN || ea.getKey() != 'p')
+        return false;
+
+    std::lock_guard<std::mutex> guard(game->get_lock());
+
+    auto timer = osg::Timer::instance();
+    auto start = timer->tick();
+    auto count = index->find(*game->get_board(), games, 10);
+    auto elapsed = timer->delta_m(start, timer->tick());
+
+    std::cout << count << " archived game" << (count == 1 ? "" : "s") << " reach this position (" << std::fixed
+              << std::setprecision(3) << elapsed << " ms)";
+    if (count)
+    {
+        std::cout << ":";
+        for (auto game_number : games)
+            std::cout << " " << game_number;
+        if (count > games.size())
+            std::cout << " ...";
     }
+    std::cout << std::endl;
+
+    return true;
+}
+
+ExplorerHandler::ExplorerHandler(GamePtr game_, std::shared_ptr<const OpeningExplorer> explorer_) :
+    game(game_), explorer(explorer_)
+{}
+
+bool ExplorerHandler::handle(const osgGA::GUIEventAdapter &ea, osgGA::GUIActionAdapter & /*aa*/)
+{
+    if (ea.getEventType() != osgGA::GUIEventAdapter::KEYDOWN || ea.getKey() != 'e')
+        return false;
+
+    std::lock_guard<std::mutex> guard(game->get_lock());
+
+    auto timer = osg::Timer::instance();
+    auto start = timer->tick();
+    explorer->find(*game->get_board(), moves);
+    auto elapsed = timer->delta_m(start, timer->tick());
+
+    std::cout << moves.size() << " archived move" << (moves.size() == 1 ? "" : "s") << " from this position ("
+              << std::fixed << std::setprecision(3) << elapsed << " ms)" << std::endl;
 
-    if (node_id.size())
+    for (const auto &move : moves)
     {
-        // it's a move
-        std::string square_str;
+        auto games = move.games();
+        std::cout << "  ";
+        write_move(std::cout, move.move);
+        if (move.move.promotion == Chessboard::Piece::Rank::Empty)
+            std::cout << "  ";
+        std::cout << std::setw(8) << games << " games  " << std::setprecision(1) << std::setw(5)
+                  << 100. * move.white_wins / games << "% / " << std::setw(5) << 100. * move.draws / games << "% / "
+                  << std::setw(5) << 100. * move.black_wins / games << "%" << std::endl;
+    }
 
-        if (node_id.substr(0, 12) == "Marker.Move.")
-            square_str = node_id.substr(12, node_id.size());
-        else if (node_id.substr(0, 14) == "Marker.Attack.")
-            square_str = node_id.substr(14, node_id.size());
+    return true;
+}
 
-        auto index = square_str.find(".");
-        std::string row_str = square_str.substr(0, index);
-        std::string col_str = square_str.substr(index + 1, square_str.size());
+HistoryHandler::HistoryHandler(GamePtr game_, GameHistoryPtr history_) : game(game_), history(history_)
+{}
 
-        auto row = std::stoi(row_str);
-        auto col = std::stoi(col_str);
+bool HistoryHandler::handle(const osgGA::GUIEventAdapter &ea, osgGA::GUIActionAdapter & /*aa*/)
+{
+    if (ea.getEventType() != osgGA::GUIEventAdapter::KEYDOWN)
+        return false;
 
-        board->move_selected_to(row, col);
+    std::lock_guard<std::mutex> guard(game->get_lock());
 
+    switch (ea.getKey())
+    {
+    case osgGA::GUIEventAdapter::KEY_Left:
+        history->undo();
+        break;
+    case osgGA::GUIEventAdapter::KEY_Right:
+        history->redo();
+        break;
+    case osgGA::GUIEventAdapter::KEY_Home:
+        history->seek(0);
+        break;
+    case osgGA::GUIEventAdapter::KEY_End:
+        history->seek(history->size());
+        break;
+    case 'l':
+    {
+        // the move list, with a bar where the board stands
+        const auto &moves = history->get_moves();
+        for (std::size_t i = 0; i < moves.size(); ++i)
+        {
+            if (i == history->get_ply())
+                std::cout << " |";
+            if (i % 2 == 0)
+                std::cout << " " << (i / 2 + 1) << ".";
+            std::cout << " ";
+            write_move(std::cout, moves[i]);
+        }
+        if (history->get_ply() == moves.size())
+            std::cout << " |";
+        std::cout << std::endl;
         return true;
     }
+    default:
+        return false;
+    }
 
-    return false;
+    std::cout << "ply " << history->get_ply() << " of " << history->size() << std::endl;
+    return true;
 }
@@ -24,8 +24,15 @@
 // IN THE SOFTWARE.
 //------------------------------------------------------------------------------
 
+#include <memory>
+#include <vector>
+
 #include "OSG.h"
 #include "Chessboard.h"
+#include "Game.h"
+#include "GameHistory.h"
+#include "OpeningExplorer.h"
+#include "PositionIndex.h"
 
 // PickHandlerInterface -- An interface class, based on GUIEventHandler,
 // that implements picking.  Derived classes need to override the
@@ -33,10 +40,27 @@
 
 class PickHandlerInterface : public osgGA::GUIEventHandler
 {
+public:
+    // how meshes are intersected when a pick can't be resolved from the
+    // board plane alone
+    enum class PickMode
+    {
+        Polytope,   // a small polytope around the mouse, tested against every triangle
+        Ray,        // a ray through the mouse, tested against every triangle
+        KdTreeRay   // a ray through the mouse, tested against the meshes' KD-trees
+    };
+
 public:
     PickHandlerInterface();
     bool handle( const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa ) override;
 
+    void set_pick_mode( PickMode mode ) { pick_mode = mode; }
+    PickMode get_pick_mode() const { return pick_mode; }
+
+    // intersect the scene's meshes under a normalized mouse position,
+    // returning the node path of the nearest hit
+    bool intersect_meshes( const double x, const double y, osg::Camera* camera, osg::NodePath& nodePath ) const;
+
 protected:
     // store mouse xy location for button press & move events.
     float _mX{0.0f};
@@ -45,22 +69,99 @@ protected:
     // Remember the previous selection;
     osg::ref_ptr<osg::MatrixTransform> _selectedNode;
 
+    PickMode pick_mode{PickMode::KdTreeRay};
+
+    enum class RayResult
+    {
+        Picked,     // the ray identified something, and it was handled
+        Missed,     // the ray identified nothing of interest
+        Ambiguous   // the ray alone can't tell; intersect the scene instead
+    };
+
     // perform a pick operation.
     bool pick( const double x, const double y, osgViewer::Viewer* viewer );
 
+    // world-space ray through the normalized mouse position
+    bool compute_ray( const double x, const double y, osgViewer::Viewer* viewer,
+                      osg::Vec3d& near_point, osg::Vec3d& far_point );
+
+    // fast path: resolve a pick from the ray alone, without traversing
+    // the scene graph.  the default defers to process_pick().
+    virtual RayResult process_ray( const osg::Vec3d& /*near_point*/, const osg::Vec3d& /*far_point*/ )
+    {
+        return RayResult::Ambiguous;
+    }
+
     virtual bool process_pick(const osg::NodePath& nodePath) = 0;
 };
 
 class SelectionHandler : public PickHandlerInterface
 {
 public:
-    SelectionHandler( ChessboardPtr board_, NodePtr sg_root_ );
+    SelectionHandler( GamePtr game_ );
     ~SelectionHandler() override {}
 
+    // only let the player here pick up one side's pieces (e.g., when the
+    // other side is played elsewhere); both by default
+    void set_player_side( Chessboard::Side side ) { player_sides = side; }
+
 protected:  // data members
+    GamePtr         game;
     ChessboardPtr   board;
-    NodePtr         sg_root;
+
+    // the board cell under the last ambiguous ray, if any
+    Position        surface_cell{-1, -1};
+
+    int             player_sides{Chessboard::White | Chessboard::Black};
 
 protected:  // methods
+    bool select_cell( int row, int col );
+
+    RayResult process_ray( const osg::Vec3d& near_point, const osg::Vec3d& far_point ) override;
     bool process_pick( const osg::NodePath& nodePath ) override;
 };
+
+// PositionQueryHandler -- on 'p', reports the archived games that reach
+// the board's current position (see PositionIndex)
+
+class PositionQueryHandler : public osgGA::GUIEventHandler
+{
+public:
+    PositionQueryHandler( GamePtr game_, std::shared_ptr<const PositionIndex> index_ );
+    bool handle( const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa ) override;
+
+protected:
+    GamePtr game;
+    std::shared_ptr<const PositionIndex> index;
+    std::vector<std::uint32_t> games;
+};
+
+// ExplorerHandler -- on 'e', lists the moves archived games played from the
+// board's current position, with how those games ended (see OpeningExplorer)
+
+class ExplorerHandler : public osgGA::GUIEventHandler
+{
+public:
+    ExplorerHandler( GamePtr game_, std::shared_ptr<const OpeningExplorer> explorer_ );
+    bool handle( const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa ) override;
+
+protected:
+    GamePtr game;
+    std::shared_ptr<const OpeningExplorer> explorer;
+    std::vector<ExplorerMove> moves;
+};
+
+// HistoryHandler -- steps through the game's history: left and right take
+// back and remake a move, home and end go to the start and the latest
+// move, and 'l' lists the moves (see GameHistory)
+
+class HistoryHandler : public osgGA::GUIEventHandler
+{
+public:
+    HistoryHandler( GamePtr game_, GameHistoryPtr history_ );
+    bool handle( const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa ) override;
+
+protected:
+    GamePtr game;
+    GameHistoryPtr history;
+};
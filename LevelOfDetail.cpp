@@ -0,0 +1,82 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cfloat>
+
+#include "LevelOfDetail.h"
+#include "Visitors.h"
+
+const DetailLevels &default_detail_levels()
+{
+    static const DetailLevels levels = {{1.0f, 1.5f}, {0.4f, 4.0f}, {0.1f, FLT_MAX}};
+    return levels;
+}
+
+LodBuilder::LodBuilder(const DetailLevels &levels_) : levels(levels_) {}
+
+NodePtr LodBuilder::get(NodePtr mesh)
+{
+    // a single level needs no LOD at all
+    if (!mesh.valid() || levels.size() < 2)
+        return mesh;
+
+    auto iter = lods.find(mesh.get());
+    if (iter != lods.end())
+        return iter->second;
+
+    osg::ref_ptr<osg::LOD> lod(new osg::LOD);
+    lod->setName(mesh->getName() + ".LOD");
+    lod->setRangeMode(osg::LOD::DISTANCE_FROM_EYE_POINT);
+
+    auto min_distance = 0.f;
+    for (const auto &level : levels)
+    {
+        NodePtr detail = mesh;
+        if (level.sample_ratio < 1.f)
+        {
+            // the simplifier rewrites the geometry in place, so it needs its
+            // own copy of the vertex data; state is still shared
+            detail = osg::clone(mesh.get(), osg::CopyOp(osg::CopyOp::DEEP_COPY_NODES |
+                                                         osg::CopyOp::DEEP_COPY_DRAWABLES |
+                                                         osg::CopyOp::DEEP_COPY_ARRAYS |
+                                                         osg::CopyOp::DEEP_COPY_PRIMITIVES));
+
+            // the copied KD-trees would describe the original triangles
+            CollectGeometries collector;
+            detail->accept(collector);
+            for (auto &geometry : collector.geometries)
+                geometry->setShape(nullptr);
+
+            osgUtil::Simplifier simplifier(level.sample_ratio);
+            detail->accept(simplifier);
+        }
+
+        lod->addChild(detail.get(), min_distance, level.max_distance);
+        min_distance = level.max_distance;
+    }
+
+    NodePtr node = lod.get();
+    lods[mesh.get()] = node;
+    return node;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <map>
+#include <vector>
+
+#include "OSG.h"
+
+// DetailLevel -- one step in a mesh's level-of-detail chain: the mesh is
+// simplified to keep about sample_ratio of its triangles, and is drawn
+// while the eye is no farther than max_distance from it
+
+struct DetailLevel
+{
+    float sample_ratio;
+    float max_distance;
+};
+
+using DetailLevels = std::vector<DetailLevel>;
+
+// full detail across a single board, coarser as the camera pulls back
+// (the board is 0.4 units across, and the home view is ~1.2 units away)
+const DetailLevels &default_detail_levels();
+
+// LodBuilder -- wraps a mesh in an osg::LOD holding simplified copies of
+// it, one per detail level.  The LOD for a given mesh is built once and
+// shared by every node that draws it, just as the meshes are.  The first
+// level is always the mesh itself, so picking (which intersects the
+// highest level of detail) keeps using its KD-trees.
+
+class LodBuilder : public osg::Referenced
+{
+public:
+    LodBuilder(const DetailLevels &levels_);
+
+    NodePtr get(NodePtr mesh);
+
+protected:
+    DetailLevels levels;
+    std::map<osg::Node *, NodePtr> lods;    // source mesh -> its LOD
+};
+
+using LodBuilderPtr = osg::ref_ptr<LodBuilder>;
@@ -0,0 +1,45 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+
+// the byte order of the files and messages the program reads and writes,
+// whatever the machine's own
+
+// a little-endian unsigned integer of the given number of bytes
+inline std::uint64_t read_le(const unsigned char *p, int bytes)
+{
+    std::uint64_t value = 0;
+    for (auto i = 0; i < bytes; ++i)
+        value |= std::uint64_t(p[i]) << (8 * i);
+    return value;
+}
+
+inline void write_le(unsigned char *p, std::uint64_t value, int bytes)
+{
+    for (auto i = 0; i < bytes; ++i, value >>= 8)
+        p[i] = static_cast<unsigned char>(value & 0xff);
+}
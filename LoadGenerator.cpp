@@ -0,0 +1,356 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "GameServer.h"
+#include "LittleEndian.h"
+#include "LoadGenerator.h"
+#include "Rules.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+// games are given up after this many plies, so they don't wander forever
+static const int longest_game = 300;
+
+struct LoadReport
+{
+    std::uint64_t moves{0};
+    std::uint64_t finished{0};
+    std::uint64_t refused{0};
+    std::vector<float> latencies;   // microseconds, one per move
+    bool failed{false};
+};
+
+// pick one of the side to move's legal moves at random; false if it has none
+
+static bool random_move(const Rules::Board &board, std::mt19937 &random, int &from, int &to)
+{
+    unsigned char moves[256][2];
+    auto count = 0;
+
+    for (auto cell = 0; cell < 64; ++cell)
+    {
+        if ((board.cells[cell] >> 3) != board.to_move)
+            continue;
+
+        auto mask = Rules::legal_moves(board, cell / 8, cell % 8);
+        for (auto bits = mask.moves | mask.captures; bits && count < 256; bits &= bits - 1)
+        {
+            auto target = 0;
+            while (!(bits & (std::uint64_t(1) << target)))
+                ++target;
+
+            moves[count][0] = static_cast<unsigned char>(cell);
+            moves[count][1] = static_cast<unsigned char>(target);
+            ++count;
+        }
+    }
+
+    if (!count)
+        return false;
+
+    auto pick = std::uniform_int_distribution<int>(0, count - 1)(random);
+    from = moves[pick][0];
+    to = moves[pick][1];
+    return true;
+}
+
+static int connect_local(const std::string &path)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+        return -1;
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+
+    auto socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket < 0)
+        return -1;
+
+    if (connect(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)))
+    {
+        close(socket);
+        return -1;
+    }
+
+    return socket;
+}
+
+// write as much of the queue as the socket takes without blocking, and drop
+// what was written; false once the server has gone
+
+static bool send_some(int socket, std::vector<unsigned char> &data)
+{
+    auto result = send(socket, data.data(), data.size(), MSG_NOSIGNAL);
+    if (result < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    data.erase(data.begin(), data.begin() + result);
+    return true;
+}
+
+// one connection's share of the load: its games, each with a copy of the
+// board to choose moves on, and the requests it's waiting to hear back
+// about (in the order they were sent, as the replies come).  The socket
+// doesn't block: the server stops reading while its replies go unread, so
+// requests are only written as it takes them, and replies are read meanwhile
+
+static void play_games(const std::string &path, int count, Clock::time_point deadline, unsigned int seed,
+                       LoadReport &report)
+{
+    struct Game
+    {
+        Rules::Board board;
+        std::uint32_t number{0};
+        int plies{0};
+        int from{0};
+        int to{0};
+    };
+
+    struct Pending
+    {
+        int game;
+        Clock::time_point sent_at;
+    };
+
+    auto socket = connect_local(path);
+    if (socket < 0)
+    {
+        std::cerr << "Can't connect to '" << path << "': " << std::strerror(errno) << std::endl;
+        report.failed = true;
+        return;
+    }
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK);
+
+    std::mt19937 random(seed);
+    std::vector<Game> games(count);
+    std::deque<Pending> pending;
+    std::vector<unsigned char> outgoing;
+
+    auto frame = [&](char type, int from, int to, std::uint32_t value) {
+        unsigned char bytes[GameServer::frame_size] = {static_cast<unsigned char>(type), static_cast<unsigned char>(from),
+                                                       static_cast<unsigned char>(to), Rules::Queen};
+        write_le(bytes + 4, value, 4);
+        outgoing.insert(outgoing.end(), bytes, bytes + GameServer::frame_size);
+    };
+
+    auto start_game = [&](int index, Clock::time_point now) {
+        frame('N', 0, 0, 0);
+        pending.push_back(Pending{index, now});
+    };
+
+    // send the next move in a game, or end it (and start another)
+    auto next_move = [&](int index, Clock::time_point now) {
+        Game &game = games[index];
+        if (game.plies < longest_game && random_move(game.board, random, game.from, game.to))
+        {
+            frame('M', game.from, game.to, game.number);
+            pending.push_back(Pending{index, now});
+            return;
+        }
+
+        ++report.finished;
+        frame('Q', 0, 0, game.number);
+        if (now < deadline)
+            start_game(index, now);
+    };
+
+    auto now = Clock::now();
+    for (auto index = 0; index < count; ++index)
+        start_game(index, now);
+
+    unsigned char buffer[16384];
+    std::size_t buffered = 0;
+
+    while (!pending.empty() || !outgoing.empty())
+    {
+        pollfd waiting{socket, POLLIN, 0};
+        if (!outgoing.empty())
+            waiting.events |= POLLOUT;
+
+        if (poll(&waiting, 1, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            report.failed = true;
+            break;
+        }
+
+        if (!outgoing.empty() && !send_some(socket, outgoing))
+        {
+            std::cerr << "The server closed the connection." << std::endl;
+            report.failed = true;
+            break;
+        }
+
+        if (!(waiting.revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+
+        auto received = recv(socket, buffer + buffered, sizeof(buffer) - buffered, 0);
+        if (received <= 0)
+        {
+            if (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+                continue;
+            std::cerr << "The server closed the connection." << std::endl;
+            report.failed = true;
+            break;
+        }
+        buffered += received;
+
+        now = Clock::now();
+        auto ending = (now >= deadline);
+
+        std::size_t used = 0;
+        for (; buffered - used >= GameServer::frame_size && !pending.empty(); used += GameServer::frame_size)
+        {
+            const unsigned char *reply = buffer + used;
+            auto request = pending.front();
+            pending.pop_front();
+
+            Game &game = games[request.game];
+
+            switch (reply[0])
+            {
+                case 'G':
+                    Rules::start(game.board);
+                    game.number = static_cast<std::uint32_t>(read_le(reply + 4, 4));
+                    game.plies = 0;
+                    if (ending)
+                        frame('Q', 0, 0, game.number);
+                    else
+                        next_move(request.game, now);
+                    break;
+
+                case 'A':
+                    ++report.moves;
+                    report.latencies.push_back(
+                        static_cast<float>(std::chrono::duration<double, std::micro>(now - request.sent_at).count()));
+
+                    Rules::make_move(game.board, game.from / 8, game.from % 8, game.to / 8, game.to % 8);
+                    ++game.plies;
+
+                    if (reply[1] == GameServer::Checkmate || reply[1] == GameServer::Stalemate)
+                        game.plies = longest_game;
+                    if (ending)
+                        frame('Q', 0, 0, game.number);
+                    else
+                        next_move(request.game, now);
+                    break;
+
+                case 'R':
+                    // the server and this board disagree; start the game over
+                    ++report.refused;
+                    game.plies = longest_game;
+                    if (ending)
+                        frame('Q', 0, 0, game.number);
+                    else
+                        next_move(request.game, now);
+                    break;
+
+                default:
+                    std::cerr << "The server has no board for another game." << std::endl;
+                    report.failed = true;
+                    pending.clear();
+                    outgoing.clear();
+                    break;
+            }
+        }
+
+        buffered -= used;
+        std::memmove(buffer, buffer + used, buffered);
+    }
+
+    close(socket);
+}
+
+int benchmark_server(const std::string &path, int connections, int games, double seconds)
+{
+    connections = std::max(1, connections);
+    games = std::max(1, games);
+
+    std::vector<LoadReport> reports(connections);
+    std::vector<std::thread> threads;
+
+    auto started = Clock::now();
+    auto deadline = started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+
+    for (auto index = 0; index < connections; ++index)
+        threads.emplace_back(play_games, path, games, deadline, 1234u + index, std::ref(reports[index]));
+    for (auto &thread : threads)
+        thread.join();
+
+    auto elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+
+    LoadReport total;
+    for (auto &report : reports)
+    {
+        total.moves += report.moves;
+        total.finished += report.finished;
+        total.refused += report.refused;
+        total.failed = total.failed || report.failed;
+        total.latencies.insert(total.latencies.end(), report.latencies.begin(), report.latencies.end());
+    }
+
+    if (total.latencies.empty())
+    {
+        std::cerr << "No moves were made." << std::endl;
+        return 1;
+    }
+
+    auto percentile = [&](double fraction) {
+        auto rank = static_cast<std::size_t>(fraction * (total.latencies.size() - 1));
+        std::nth_element(total.latencies.begin(), total.latencies.begin() + rank, total.latencies.end());
+        return total.latencies[rank];
+    };
+
+    auto median = percentile(0.5);
+    auto p99 = percentile(0.99);
+    auto worst = *std::max_element(total.latencies.begin(), total.latencies.end());
+
+    std::cout << total.moves << " moves in " << std::fixed << std::setprecision(2) << elapsed << " s, over "
+              << connections << " connections of " << games << " games each: " << std::setprecision(0)
+              << (total.moves / elapsed) << " moves/s; " << std::setprecision(1) << median << " us median, " << p99
+              << " us p99, " << worst << " us worst; " << total.finished << " games finished, " << total.refused
+              << " moves refused" << std::endl;
+
+    return (total.failed || total.refused) ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string &path, bool random_access)
+{
+    close();
+
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       random_access ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE)
+        file = nullptr;
+    else if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    {
+        mapped_length = static_cast<std::size_t>(size.QuadPart);
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+            mapped = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    file = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (file >= 0 && !fstat(file, &st) && st.st_size > 0)
+    {
+        mapped_length = static_cast<std::size_t>(st.st_size);
+        auto address = mmap(nullptr, mapped_length, PROT_READ, MAP_SHARED, file, 0);
+        if (address != MAP_FAILED)
+        {
+            madvise(address, mapped_length, random_access ? MADV_RANDOM : MADV_SEQUENTIAL);
+            mapped = static_cast<const unsigned char *>(address);
+        }
+    }
+#endif
+
+    if (mapped)
+        return true;
+
+    close();
+    return false;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (mapped)
+        UnmapViewOfFile(mapped);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+    mapping = nullptr;
+    file = nullptr;
+#else
+    if (mapped)
+        munmap(const_cast<unsigned char *>(mapped), mapped_length);
+    if (file >= 0)
+        ::close(file);
+    file = -1;
+#endif
+
+    mapped = nullptr;
+    mapped_length = 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// MappedFile -- a file mapped read-only into memory, for the sorted tables
+// (see PositionIndex, OpeningExplorer) that are searched in place rather
+// than read in.
+
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile();
+
+    // random_access: advise the system not to read ahead of the accesses
+    bool open(const std::string &path, bool random_access = true);
+    void close();
+
+    const unsigned char *data() const
+    {
+        return mapped;
+    }
+    std::size_t size() const
+    {
+        return mapped_length;
+    }
+
+protected:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const unsigned char *mapped{nullptr};
+    std::size_t mapped_length{0};
+
+#ifdef _WIN32
+    void *file{nullptr};
+    void *mapping{nullptr};
+#else
+    int file{-1};
+#endif
+};
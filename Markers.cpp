@@ -0,0 +1,145 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include "Markers.h"
+#include "Game.h"
+#include "Visitors.h"
+
+// the marker's vertices are offset by the position of the cell being
+// drawn; lighting mirrors the fixed-function pipeline the other meshes use
+
+static const char *marker_vertex_shader =
+    "#version 130\n"
+    "#extension GL_ARB_draw_instanced : require\n"
+    "uniform vec3 marker_offsets[64];\n"
+    "out vec3 normal;\n"
+    "out vec3 view_position;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 vertex = gl_Vertex + vec4(marker_offsets[gl_InstanceIDARB], 0.0);\n"
+    "    vec4 eye = gl_ModelViewMatrix * vertex;\n"
+    "    view_position = eye.xyz;\n"
+    "    normal = gl_NormalMatrix * gl_Normal;\n"
+    "    gl_Position = gl_ProjectionMatrix * eye;\n"
+    "}\n";
+
+static const char *marker_fragment_shader =
+    "#version 130\n"
+    "in vec3 normal;\n"
+    "in vec3 view_position;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 n = normalize(normal);\n"
+    "    vec3 l = normalize(gl_LightSource[0].position.xyz - view_position * gl_LightSource[0].position.w);\n"
+    "    float diffuse = abs(dot(n, l));\n"
+    "    vec4 color = gl_FrontMaterial.emission\n"
+    "               + gl_FrontMaterial.ambient * (gl_LightModel.ambient + gl_LightSource[0].ambient)\n"
+    "               + gl_FrontMaterial.diffuse * gl_LightSource[0].diffuse * diffuse;\n"
+    "    gl_FragColor = vec4(color.rgb, gl_FrontMaterial.diffuse.a);\n"
+    "}\n";
+
+InstancedMarkers::InstancedMarkers(ChessboardPtr board, NodePtr mesh, const std::string &name)
+{
+    Chessboard &cb = *board;
+
+    for (auto row : Game::one_rank)
+    {
+        for (auto col : Game::one_rank)
+        {
+            auto center = cb(row, col).get_center();
+            centers[row * 8 + col].set(center.x, center.y, 0.021);
+        }
+    }
+
+    root = new osg::Group;
+    root->setName(name);
+    root->setDataVariance(osg::Object::DYNAMIC);
+    root->setNodeMask(0); // nothing to show yet
+
+    if (!mesh.valid())
+        return;
+
+    // each board needs its own primitive sets (their instance counts
+    // differ), but can keep sharing the mesh's vertex data and state
+
+    NodePtr instanced = osg::clone(mesh.get(), osg::CopyOp(osg::CopyOp::DEEP_COPY_NODES |
+                                                            osg::CopyOp::DEEP_COPY_DRAWABLES |
+                                                            osg::CopyOp::DEEP_COPY_PRIMITIVES));
+    root->addChild(instanced.get());
+
+    // the instances are spread across the board, so the meshes' own
+    // bounds won't do for culling
+
+    osg::BoundingBox board_bounds(-0.25f, -0.25f, 0.f, 0.25f, 0.25f, 0.05f);
+
+    CollectGeometries collector;
+    instanced->accept(collector);
+    for (auto &geometry : collector.geometries)
+    {
+        geometry->setUseDisplayList(false);
+        geometry->setUseVertexBufferObjects(true);
+        geometry->setDataVariance(osg::Object::DYNAMIC);
+        geometry->setInitialBound(board_bounds);
+
+        for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); ++i)
+            primitives.push_back(geometry->getPrimitiveSet(i));
+    }
+
+    osg::ref_ptr<osg::Program> program(new osg::Program);
+    program->addShader(new osg::Shader(osg::Shader::VERTEX, marker_vertex_shader));
+    program->addShader(new osg::Shader(osg::Shader::FRAGMENT, marker_fragment_shader));
+
+    offsets = new osg::Uniform(osg::Uniform::FLOAT_VEC3, "marker_offsets", 64);
+    offsets->setDataVariance(osg::Object::DYNAMIC);
+
+    auto state_set = root->getOrCreateStateSet();
+    state_set->setAttributeAndModes(program.get());
+    state_set->addUniform(offsets.get());
+    state_set->setDataVariance(osg::Object::DYNAMIC);
+}
+
+void InstancedMarkers::set_mask(std::uint64_t mask_)
+{
+    if (mask_ == mask)
+        return;
+    mask = mask_;
+
+    if (!offsets.valid())
+        return;
+
+    // pack the visible cells' offsets at the front of the array, and
+    // draw just that many instances
+
+    auto count = 0;
+    for (auto bits = mask; bits; bits &= bits - 1)
+        offsets->setElement(count++, centers[lowest_bit(bits)]);
+
+    for (auto &primitive : primitives)
+    {
+        primitive->setNumInstances(count);
+        primitive->dirty();
+    }
+
+    root->setNodeMask(count ? RenderMask : 0);
+}
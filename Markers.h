@@ -0,0 +1,61 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include "OSG.h"
+#include "Chessboard.h"
+
+// InstancedMarkers -- draws a marker mesh over any subset of the 64 board
+// cells with one instanced draw per geometry, instead of a Switch and
+// MatrixTransform per cell.  The visible cells are given as a bitmask
+// (see Chessboard::cell_bit()); only those cells' offsets are uploaded,
+// so hidden markers cost nothing to cull or draw.
+
+class InstancedMarkers : public osg::Referenced
+{
+public:
+    InstancedMarkers(ChessboardPtr board, NodePtr mesh, const std::string &name);
+
+    NodePtr get_node() const
+    {
+        return root;
+    }
+
+    std::uint64_t get_mask() const
+    {
+        return mask;
+    }
+    void set_mask(std::uint64_t mask_);
+
+protected:
+    osg::ref_ptr<osg::Group> root;
+    osg::ref_ptr<osg::Uniform> offsets;
+    std::vector< osg::ref_ptr<osg::PrimitiveSet> > primitives;
+
+    osg::Vec3 centers[64];      // marker position for each cell, indexed by (row * 8 + col)
+    std::uint64_t mask{0};
+};
+
+using InstancedMarkersPtr = osg::ref_ptr<InstancedMarkers>;
@@ -0,0 +1,333 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "LittleEndian.h"
+#include "MoveJournal.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const std::uint16_t journal_version = 1;
+static const std::size_t header_size = 136;
+static const std::size_t record_size = 8;
+static const std::size_t fen_field = header_size - 8;
+
+// push what's been written through to the disk itself
+
+static void sync_file(std::FILE *file)
+{
+    std::fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
+
+// write a whole new journal beside the old one, and put it in the old
+// one's place once it's on the disk, so a crash leaves one or the other;
+// returns the new journal, open for appending
+
+static std::FILE *start_journal(const std::string &path, const std::string &fen,
+                                const std::vector<unsigned char> &records)
+{
+    auto temporary = path + ".new";
+    auto file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+        return nullptr;
+
+    unsigned char header[header_size] = {'O', 'C', 'M', 'J'};
+    write_le(header + 4, journal_version, 2);
+    write_le(header + 6, record_size, 2);
+    std::memcpy(header + 8, fen.data(), std::min(fen.size(), fen_field - 1));
+
+    auto written = std::fwrite(header, 1, header_size, file) == header_size &&
+                   std::fwrite(records.data(), 1, records.size(), file) == records.size();
+    sync_file(file);
+    std::fclose(file);
+
+#ifdef _WIN32
+    // (rename won't replace an existing file here)
+    std::remove(path.c_str());
+#endif
+    if (!written || std::rename(temporary.c_str(), path.c_str()))
+        return nullptr;
+
+    return std::fopen(path.c_str(), "ab");
+}
+
+MoveJournal::MoveJournal(ChessboardPtr board_, const std::string &path_, std::chrono::milliseconds sync_interval_) :
+    board(board_), path(path_), sync_interval(sync_interval_)
+{
+    writer = std::thread(&MoveJournal::write_loop, this);
+}
+
+MoveJournal::~MoveJournal()
+{
+    board->remove_listener(this);
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+}
+
+std::size_t MoveJournal::restore(GameHistory *history)
+{
+    std::vector<unsigned char> data;
+    if (auto file = std::fopen(path.c_str(), "rb"))
+    {
+        unsigned char buffer[65536];
+        std::size_t length;
+        while ((length = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+            data.insert(data.end(), buffer, buffer + length);
+        std::fclose(file);
+    }
+
+    Chessboard::FenPosition start;
+    std::string fen;
+    auto valid = data.size() >= header_size && !std::memcmp(data.data(), "OCMJ", 4) &&
+                 read_le(data.data() + 4, 2) == journal_version && read_le(data.data() + 6, 2) == record_size;
+    if (valid)
+    {
+        auto field = reinterpret_cast<const char *>(data.data() + 8);
+        fen.assign(field, std::find(field, field + fen_field, '\0'));
+        valid = Chessboard::parse_fen(fen.data(), fen.size(), start);
+    }
+
+    if (!valid)
+    {
+        if (!data.empty())
+            osg::notify(osg::WARN) << "Can't read move journal '" << path << "'; starting a new one." << std::endl;
+
+        board_reset();
+        board->add_listener(this);
+        return 0;
+    }
+
+    // the line of play the journal ends on, and the ply it was left at;
+    // anything after a record that doesn't make sense (e.g., one torn in
+    // a crash) can't be trusted
+    std::vector<PgnMove> moves;
+    std::size_t shown = 0;
+    for (auto p = data.data() + header_size; p + record_size <= data.data() + data.size(); p += record_size)
+    {
+        auto ply = read_le(p + 4, 4);
+        if (p[0] == 'M' && p[1] < 64 && p[2] < 64 && p[3] <= static_cast<int>(Chessboard::Piece::Rank::Pawn) &&
+            ply <= moves.size())
+        {
+            PgnMove move;
+            move.from = p[1];
+            move.to = p[2];
+            move.promotion = static_cast<Chessboard::Piece::Rank>(p[3]);
+
+            moves.resize(ply);
+            moves.push_back(move);
+            shown = moves.size();
+        }
+        else if (p[0] == 'S' && ply <= moves.size())
+            shown = ply;
+        else
+            break;
+    }
+
+    // with a history, the whole line goes in it; otherwise, only the moves
+    // up to the ply shown are needed
+    board->set_position(start);
+    auto replay = history ? moves.size() : shown;
+    for (std::size_t i = 0; i < replay; ++i)
+    {
+        const auto &move = moves[i];
+        board->select((*board)(move.from / 8, move.from % 8));
+        if (!board->move_selected_to(move.to / 8, move.to % 8, move.promotion))
+        {
+            osg::notify(osg::WARN) << "Move journal '" << path << "' has an illegal move at ply " << i
+                                   << "; restored the game up to it." << std::endl;
+            moves.resize(i);
+            shown = std::min(shown, i);
+            break;
+        }
+    }
+    board->clear_selection();
+
+    if (history)
+        history->seek(shown);
+    else
+        moves.resize(std::min(shown, moves.size()));
+
+    // start the file over with just that, leaving out any moves taken back
+    // (and any torn record)
+    begin(fen, start.fullmove_number, start.to_move == Chessboard::Black);
+    for (std::size_t i = 0; i < moves.size(); ++i)
+        queue('M', moves[i].from, moves[i].to, moves[i].promotion, static_cast<int>(i));
+    if (shown < moves.size())
+        queue('S', 0, 0, Chessboard::Piece::Rank::Empty, static_cast<int>(shown));
+
+    board->add_listener(this);
+    return moves.size();
+}
+
+int MoveJournal::current_ply() const
+{
+    auto ply = (board->get_fullmove_number() - start_fullmove) * 2 + (board->local_side() == Chessboard::Black ? 1 : 0) -
+               (start_black ? 1 : 0);
+    return std::max(ply, 0);
+}
+
+void MoveJournal::board_reset()
+{
+    begin(board->to_fen(), board->get_fullmove_number(), board->local_side() == Chessboard::Black);
+}
+
+void MoveJournal::position_changed()
+{
+    queue('S', 0, 0, Chessboard::Piece::Rank::Empty, current_ply());
+}
+
+void MoveJournal::move_made(int from_row, int from_col, int to_row, int to_col, Chessboard::Piece::Rank promotion)
+{
+    queue('M', from_row * 8 + from_col, to_row * 8 + to_col, promotion, current_ply() - 1);
+}
+
+// a new game: whatever hasn't been written yet belongs to the old one
+
+void MoveJournal::begin(const std::string &fen, int fullmove_number, bool black_to_move)
+{
+    start_fullmove = fullmove_number;
+    start_black = black_to_move;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        pending.clear();
+        rewrite = true;
+        start_fen = fen;
+        ++queued;
+    }
+    wake.notify_one();
+}
+
+void MoveJournal::queue(char kind, int from, int to, Chessboard::Piece::Rank promotion, int ply)
+{
+    unsigned char record[record_size] = {static_cast<unsigned char>(kind), static_cast<unsigned char>(from),
+                                         static_cast<unsigned char>(to), static_cast<unsigned char>(promotion)};
+    write_le(record + 4, static_cast<std::uint32_t>(ply), 4);
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pending.insert(pending.end(), record, record + record_size);
+        ++queued;
+    }
+    wake.notify_one();
+}
+
+void MoveJournal::flush()
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    auto target = queued;
+    flush_requested = true;
+    wake.notify_one();
+    flushed.wait(guard, [this, target] { return synced >= target; });
+}
+
+void MoveJournal::write_loop()
+{
+    using clock = std::chrono::steady_clock;
+
+    std::FILE *file = nullptr;
+    std::vector<unsigned char> batch;
+    std::uint64_t written = 0, durable = 0;
+    auto last_sync = clock::now();
+    auto failed = false;
+
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;)
+    {
+        // sleep until there's something to do, or (with writes not yet on
+        // the disk) until the next sync falls due
+        auto work = [this] { return stopping || rewrite || flush_requested || !pending.empty(); };
+        if (written > durable)
+            wake.wait_until(guard, last_sync + sync_interval, work);
+        else
+            wake.wait(guard, work);
+
+        auto start_over = rewrite;
+        auto fen = start_fen;
+        auto stop = stopping;
+        auto force = flush_requested || stopping;
+        rewrite = flush_requested = false;
+        batch.swap(pending);
+        written = queued;
+        guard.unlock();
+
+        if (start_over)
+        {
+            if (file)
+                std::fclose(file);
+            file = start_journal(path, fen, batch);
+            durable = written;
+            last_sync = clock::now();
+        }
+        else if (file && !batch.empty())
+        {
+            std::fwrite(batch.data(), 1, batch.size(), file);
+        }
+        batch.clear();
+
+        if (written > durable && (force || clock::now() - last_sync >= sync_interval))
+        {
+            if (file)
+                sync_file(file);
+            durable = written;
+            last_sync = clock::now();
+        }
+
+        if (!file && (start_over || written > durable) && !failed)
+        {
+            osg::notify(osg::WARN) << "Can't write move journal '" << path << "'; moves won't be kept." << std::endl;
+            failed = true;
+        }
+
+        guard.lock();
+        synced = durable;
+        flushed.notify_all();
+
+        if (stop)
+            break;
+    }
+    guard.unlock();
+
+    if (file)
+        std::fclose(file);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OSG.h"
+#include "Chessboard.h"
+#include "GameHistory.h"
+
+// MoveJournal -- keeps the game in progress on disk, so a crash or a
+// restart doesn't lose it.  The journal starts with a 136-byte header
+// ("OCMJ", a u16 version, a u16 record size, and the starting position as
+// FEN, padded with zeros to 128 bytes), and a board reset writes it over.
+// After that it's only appended to, one 8-byte record per event:
+//
+//   'M', from, to, promotion, u32 ply    a move, made as the given ply
+//   'S', 0, 0, 0, u32 ply                the board was sent to a ply
+//
+// where from and to are cells (row * 8 + col), and a move at ply n drops
+// any moves at n or after it (they were taken back).  Events are queued
+// from the board's listener and written by a thread of the journal's own,
+// which flushes them to the disk at most every sync interval, so no move
+// waits on the disk.  A torn last record, if the program died while
+// writing it, is ignored.
+
+class MoveJournal : public osg::Referenced, public Chessboard::Listener
+{
+public:
+    MoveJournal(ChessboardPtr board_, const std::string &path_,
+                std::chrono::milliseconds sync_interval_ = std::chrono::milliseconds(100));
+    ~MoveJournal() override;
+
+    // put the journal's game on the board (and in the history, if given)
+    // and start journaling; an empty or unreadable journal starts over
+    // from the board as it stands.  Returns the number of moves restored.
+    std::size_t restore(GameHistory *history = nullptr);
+
+    // Chessboard::Listener
+    void piece_moved(const Chessboard::Piece &, const Chessboard::Cell &) override {}
+    void board_reset() override;
+    void side_changed(Chessboard::Side) override {}
+    void position_changed() override;
+    void move_made(int from_row, int from_col, int to_row, int to_col, Chessboard::Piece::Rank promotion) override;
+
+    // block until everything queued is on the disk
+    void flush();
+
+protected:
+    ChessboardPtr board;
+    std::string path;
+    std::chrono::milliseconds sync_interval;
+
+    // the starting position, for numbering plies (only used by whatever is
+    // changing the board)
+    int start_fullmove{1};
+    bool start_black{false};
+
+    // shared with the writer thread
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    std::vector<unsigned char> pending;     // records not yet written
+    bool rewrite{false};                    // start the file over with...
+    std::string start_fen;                  // ...this position
+    std::uint64_t queued{0};                // records queued, and synced, so far
+    std::uint64_t synced{0};
+    bool flush_requested{false};
+    bool stopping{false};
+
+    std::thread writer;
+
+    int current_ply() const;
+    void begin(const std::string &fen, int fullmove_number, bool black_to_move);
+    void queue(char kind, int from, int to, Chessboard::Piece::Rank promotion, int ply);
+    void write_loop();
+};
+
+using MoveJournalPtr = osg::ref_ptr<MoveJournal>;
@@ -0,0 +1,513 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+
+#include "LittleEndian.h"
+#include "NetPlay.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+using socket_t = SOCKET;
+static const socket_t no_socket = INVALID_SOCKET;
+
+static int poll_sockets(pollfd *sockets, unsigned int count, int timeout)
+{
+    return WSAPoll(sockets, count, timeout);
+}
+static void close_socket(socket_t socket)
+{
+    closesocket(socket);
+}
+static bool set_nonblocking(socket_t socket)
+{
+    u_long on = 1;
+    return !ioctlsocket(socket, FIONBIO, &on);
+}
+static bool would_block()
+{
+    auto error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+}
+static bool start_sockets()
+{
+    static const bool started = [] {
+        WSADATA data;
+        return !WSAStartup(MAKEWORD(2, 2), &data);
+    }();
+    return started;
+}
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using socket_t = int;
+static const socket_t no_socket = -1;
+
+static int poll_sockets(pollfd *sockets, unsigned int count, int timeout)
+{
+    return ::poll(sockets, count, timeout);
+}
+static void close_socket(socket_t socket)
+{
+    ::close(socket);
+}
+static bool set_nonblocking(socket_t socket)
+{
+    auto flags = fcntl(socket, F_GETFL, 0);
+    return flags >= 0 && !fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+}
+static bool would_block()
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS || errno == EINTR;
+}
+static bool start_sockets()
+{
+    return true;
+}
+#endif
+
+// (a peer that's gone shouldn't take the program down with SIGPIPE)
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const std::size_t frame_size = 8;
+static const int protocol_version = 1;
+static const std::uint32_t protocol_magic = 0x504e434f; // "OCNP"
+
+// connect to the first of the address's hosts that answers, giving up
+// after a while (or when told to stop)
+
+static socket_t connect_to(const std::string &address, unsigned short port, const std::atomic<bool> &stopping)
+{
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo *found = nullptr;
+    if (getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &found))
+    {
+        osg::notify(osg::WARN) << "Can't find '" << address << "'." << std::endl;
+        return no_socket;
+    }
+
+    auto connected = no_socket;
+    for (auto info = found; info && connected == no_socket && !stopping; info = info->ai_next)
+    {
+        auto socket = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (socket == no_socket)
+            continue;
+
+        if (set_nonblocking(socket) &&
+            (!connect(socket, info->ai_addr, static_cast<int>(info->ai_addrlen)) || would_block()))
+        {
+            pollfd pending = {socket, POLLOUT, 0};
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            auto result = 0;
+            while (!stopping && !(result = poll_sockets(&pending, 1, 100)) &&
+                   std::chrono::steady_clock::now() < deadline)
+                ;
+
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (result > 0 && !getsockopt(socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &length) &&
+                !error)
+            {
+                connected = socket;
+                continue;
+            }
+        }
+
+        close_socket(socket);
+    }
+    freeaddrinfo(found);
+
+    if (connected == no_socket && !stopping)
+        osg::notify(osg::WARN) << "Can't connect to " << address << ":" << port << "." << std::endl;
+
+    return connected;
+}
+
+NetPlay::NetPlay(GamePtr game_) : game(game_)
+{
+    game->get_board()->add_listener(this);
+}
+
+NetPlay::~NetPlay()
+{
+    stopping = true;
+    if (network.joinable())
+        network.join();
+
+    game->get_board()->remove_listener(this);
+}
+
+bool NetPlay::host(unsigned short port)
+{
+    if (network.joinable() || !start_sockets())
+        return false;
+
+    auto listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    int on = 1;
+    if (listener == no_socket ||
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&on), sizeof(on)) ||
+        bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) || listen(listener, 1) ||
+        !set_nonblocking(listener))
+    {
+        osg::notify(osg::WARN) << "Can't wait for a player on port " << port << "." << std::endl;
+        if (listener != no_socket)
+            close_socket(listener);
+        return false;
+    }
+
+    side = Chessboard::White;
+    osg::notify(osg::NOTICE) << "Waiting for the other player on port " << port << "." << std::endl;
+
+    start(static_cast<std::intptr_t>(listener), std::string(), port);
+    return true;
+}
+
+bool NetPlay::join(const std::string &address, unsigned short port)
+{
+    if (network.joinable() || !start_sockets())
+        return false;
+
+    side = Chessboard::Black;
+    start(static_cast<std::intptr_t>(no_socket), address, port);
+    return true;
+}
+
+void NetPlay::start(std::intptr_t listener, const std::string &address, unsigned short port)
+{
+    network = std::thread(&NetPlay::run, this, listener, address, port);
+}
+
+void NetPlay::run(std::intptr_t listener_handle, std::string address, unsigned short port)
+{
+    auto listener = static_cast<socket_t>(listener_handle);
+    auto socket = no_socket;
+
+    if (listener != no_socket)
+    {
+        pollfd waiting = {listener, POLLIN, 0};
+        while (!stopping && socket == no_socket)
+        {
+            if (poll_sockets(&waiting, 1, 100) > 0)
+                socket = accept(listener, nullptr, nullptr);
+        }
+        close_socket(listener);
+    }
+    else
+        socket = connect_to(address, port, stopping);
+
+    if (socket == no_socket)
+        return;
+
+    // moves are tiny, and shouldn't wait to be batched up
+    int on = 1;
+    set_nonblocking(socket);
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&on), sizeof(on));
+
+    {
+        std::lock_guard<std::mutex> guard(send_lock);
+        peer = static_cast<std::intptr_t>(socket);
+        outgoing.clear();
+    }
+    connected = true;
+
+    // the host says hello first, and sends the position to play from
+    if (side == Chessboard::White)
+    {
+        std::lock_guard<std::mutex> guard(game->get_lock());
+        send_frame('H', protocol_version, Chessboard::Black, 0, protocol_magic);
+        send_position();
+    }
+
+    std::vector<unsigned char> incoming;
+    unsigned char buffer[4096];
+
+    while (!stopping)
+    {
+        pollfd ready = {socket, POLLIN, 0};
+        {
+            std::lock_guard<std::mutex> guard(send_lock);
+            if (!outgoing.empty())
+                ready.events |= POLLOUT;
+        }
+
+        // (the timeout is only for noticing we're to stop, or that a send
+        // couldn't all be written)
+        if (poll_sockets(&ready, 1, 50) <= 0)
+            continue;
+
+        if ((ready.revents & POLLOUT) && !flush_outgoing())
+        {
+            osg::notify(osg::WARN) << "Lost the connection to the other player." << std::endl;
+            break;
+        }
+
+        if (!(ready.revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+
+        auto received = recv(socket, reinterpret_cast<char *>(buffer), sizeof(buffer), 0);
+        if (received == 0)
+        {
+            osg::notify(osg::NOTICE) << "The other player has left." << std::endl;
+            break;
+        }
+        if (received < 0)
+        {
+            if (would_block())
+                continue;
+
+            osg::notify(osg::WARN) << "Lost the connection to the other player." << std::endl;
+            break;
+        }
+
+        incoming.insert(incoming.end(), buffer, buffer + received);
+
+        auto understood = true;
+        std::size_t used = 0;
+        while (understood && incoming.size() - used >= frame_size)
+        {
+            auto frame = incoming.data() + used;
+            auto length = frame_size + (frame[0] == 'F' ? frame[1] : 0);
+            if (incoming.size() - used < length)
+                break;
+
+            understood = receive(frame);
+            used += length;
+        }
+        incoming.erase(incoming.begin(), incoming.begin() + used);
+
+        if (!understood)
+            break;
+    }
+
+    connected = false;
+    {
+        std::lock_guard<std::mutex> guard(send_lock);
+        peer = -1;
+        outgoing.clear();
+    }
+    close_socket(socket);
+}
+
+bool NetPlay::receive(const unsigned char *frame)
+{
+    auto value = static_cast<std::uint32_t>(read_le(frame + 4, 4));
+
+    switch (frame[0])
+    {
+    case 'H':
+    {
+        if (frame[1] != protocol_version || value != protocol_magic ||
+            (frame[2] != Chessboard::White && frame[2] != Chessboard::Black))
+        {
+            osg::notify(osg::WARN) << "The other player's program doesn't speak our protocol." << std::endl;
+            return false;
+        }
+
+        // the host tells us which side to play, and we answer
+        if (side == Chessboard::Black)
+        {
+            side = static_cast<Chessboard::Side>(frame[2]);
+            send_frame('H', protocol_version, side == Chessboard::White ? Chessboard::Black : Chessboard::White, 0,
+                       protocol_magic);
+        }
+
+        osg::notify(osg::NOTICE) << "Connected to the other player; playing "
+                                 << (side == Chessboard::White ? "White" : "Black") << "." << std::endl;
+        return true;
+    }
+
+    case 'F':
+    {
+        std::lock_guard<std::mutex> guard(game->get_lock());
+
+        applying = true;
+        auto set = game->get_board()->set_fen(reinterpret_cast<const char *>(frame + frame_size), frame[1]);
+        applying = false;
+        plies = 0;
+
+        if (!set)
+            osg::notify(osg::WARN) << "The other player sent a position that can't be played." << std::endl;
+        return set;
+    }
+
+    case 'M':
+    {
+        int from = frame[1], to = frame[2];
+        auto promotion = static_cast<Chessboard::Piece::Rank>(frame[3]);
+
+        std::lock_guard<std::mutex> guard(game->get_lock());
+        auto board = game->get_board();
+
+        // a move out of turn, out of step, or of the wrong side's piece
+        // means the boards differ
+        if (value != plies || from >= 64 || to >= 64 || board->local_side() == side ||
+            Rules::side_at(board->get_rules_board(), from / 8, from % 8) != board->local_side() ||
+            !board->is_legal(from / 8, from % 8, to / 8, to % 8))
+        {
+            osg::notify(osg::WARN) << "The other player's move " << (value + 1)
+                                   << " doesn't fit this board; ignoring it." << std::endl;
+            return true;
+        }
+
+        applying = true;
+        board->select((*board)(from / 8, from % 8));
+        board->move_selected_to(to / 8, to % 8, promotion);
+        board->clear_selection();
+        applying = false;
+
+        // show where it went
+        Chessboard::MoveMask shown;
+        shown.moves = Chessboard::cell_bit(from / 8, from % 8) | Chessboard::cell_bit(to / 8, to % 8);
+        game->highlight_moves(shown);
+
+        send_frame('A', 0, 0, 0, value);
+        return true;
+    }
+
+    case 'A':
+    {
+        Clock::time_point sent;
+        {
+            std::lock_guard<std::mutex> guard(game->get_lock());
+            if (value != sent_ply)
+                return true;
+            sent = sent_at;
+        }
+
+        auto round_trip = std::chrono::duration<double, std::milli>(Clock::now() - sent).count();
+        round_trip_total += round_trip;
+        ++round_trips;
+
+        osg::notify(osg::NOTICE) << "Move " << (value + 1) << " made on the other board: " << std::fixed
+                                 << std::setprecision(2) << round_trip << " ms round trip ("
+                                 << (round_trip_total / round_trips) << " ms mean)." << std::endl;
+        return true;
+    }
+
+    default:
+        osg::notify(osg::WARN) << "The other player sent a message we don't understand." << std::endl;
+        return false;
+    }
+}
+
+void NetPlay::board_reset()
+{
+    // a new position here is a new position there
+    if (!applying && connected)
+        send_position();
+}
+
+void NetPlay::position_changed()
+{
+    // (e.g., moves taken back)
+    if (!applying && connected)
+        send_position();
+}
+
+void NetPlay::move_made(int from_row, int from_col, int to_row, int to_col, Chessboard::Piece::Rank promotion)
+{
+    auto ply = plies++;
+    if (applying || !connected)
+        return;
+
+    sent_ply = ply;
+    sent_at = Clock::now();
+    send_frame('M', from_row * 8 + from_col, to_row * 8 + to_col, static_cast<int>(promotion), ply);
+}
+
+void NetPlay::send_position()
+{
+    char fen[Chessboard::fen_buffer_size];
+    auto length = game->get_board()->to_fen(fen, sizeof(fen));
+    plies = 0;
+
+    unsigned char frame[frame_size + Chessboard::fen_buffer_size] = {'F', static_cast<unsigned char>(length)};
+    std::memcpy(frame + frame_size, fen, length);
+    send(frame, frame_size + length);
+}
+
+void NetPlay::send_frame(char type, int a, int b, int c, std::uint32_t value)
+{
+    unsigned char frame[frame_size] = {static_cast<unsigned char>(type), static_cast<unsigned char>(a),
+                                       static_cast<unsigned char>(b), static_cast<unsigned char>(c)};
+    write_le(frame + 4, value, 4);
+    send(frame, frame_size);
+}
+
+// write straight to the socket, so the network thread needn't wake; what
+// doesn't fit waits for it to flush
+
+void NetPlay::send(const unsigned char *data, std::size_t length)
+{
+    std::lock_guard<std::mutex> guard(send_lock);
+    if (peer == -1)
+        return;
+
+    std::size_t sent = 0;
+    if (outgoing.empty())
+    {
+        auto result = ::send(static_cast<socket_t>(peer), reinterpret_cast<const char *>(data),
+                             static_cast<int>(length), MSG_NOSIGNAL);
+        if (result > 0)
+            sent = static_cast<std::size_t>(result);
+    }
+    outgoing.insert(outgoing.end(), data + sent, data + length);
+}
+
+bool NetPlay::flush_outgoing()
+{
+    std::lock_guard<std::mutex> guard(send_lock);
+
+    auto result = ::send(static_cast<socket_t>(peer), reinterpret_cast<const char *>(outgoing.data()),
+                         static_cast<int>(outgoing.size()), MSG_NOSIGNAL);
+    if (result < 0)
+        return would_block();
+
+    outgoing.erase(outgoing.begin(), outgoing.begin() + result);
+    return true;
+}
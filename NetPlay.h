@@ -0,0 +1,121 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OSG.h"
+#include "Game.h"
+
+// NetPlay -- two players, each at their own board, connected over TCP.
+// One hosts (and plays White), and the other joins (and plays Black); the
+// host's position is sent over when they connect, so a game restored from
+// a journal carries on.  Messages are 8-byte frames:
+//
+//   'H', version, side, 0, "OCNP"          hello; side is the one the
+//                                          receiver plays
+//   'F', length, 0, 0, u32 0, then FEN     the position to play from
+//   'M', from, to, promotion, u32 ply      a move (cells are row * 8 + col)
+//   'A', 0, 0, 0, u32 ply                  the move was made on this board
+//
+// where a ply counts the moves since the position was sent.  The socket
+// is non-blocking and read on a thread of our own, which makes the other
+// player's moves on the board as soon as they arrive (holding the game's
+// lock), whatever the viewer is doing.  Local moves are sent straight from
+// the board's listener, without waiting for the network thread; the
+// acknowledgement gives the round trip, from the click to the move being
+// made and highlighted on the other board.
+
+class NetPlay : public osg::Referenced, public Chessboard::Listener
+{
+public:
+    NetPlay(GamePtr game_);
+    ~NetPlay() override;
+
+    // wait for the other player on a port, or connect to one waiting at an
+    // address; either returns at once, and connects in the background
+    bool host(unsigned short port);
+    bool join(const std::string &address, unsigned short port);
+
+    // the side played on this board
+    Chessboard::Side get_side() const
+    {
+        return side;
+    }
+
+    bool is_connected() const
+    {
+        return connected;
+    }
+
+    // Chessboard::Listener
+    void piece_moved(const Chessboard::Piece &, const Chessboard::Cell &) override {}
+    void board_reset() override;
+    void side_changed(Chessboard::Side) override {}
+    void position_changed() override;
+    void move_made(int from_row, int from_col, int to_row, int to_col, Chessboard::Piece::Rank promotion) override;
+
+protected:
+    using Clock = std::chrono::steady_clock;
+
+    GamePtr game;
+    std::atomic<Chessboard::Side> side{Chessboard::White};
+    std::atomic<bool> connected{false};
+    std::atomic<bool> stopping{false};
+    std::thread network;
+
+    // the game since the position was sent (guarded by the game's lock)
+    std::uint32_t plies{0};
+    bool applying{false};       // making the other player's move
+    std::uint32_t sent_ply{0};
+    Clock::time_point sent_at;
+
+    // round trips so far (network thread only)
+    int round_trips{0};
+    double round_trip_total{0.};
+
+    // the connected socket (a SOCKET on Windows), or -1, and what didn't
+    // fit in its send buffer
+    std::mutex send_lock;
+    std::intptr_t peer{-1};
+    std::vector<unsigned char> outgoing;
+
+    void start(std::intptr_t listener, const std::string &address, unsigned short port);
+    void run(std::intptr_t listener, std::string address, unsigned short port);
+    bool receive(const unsigned char *frame);
+
+    void send(const unsigned char *data, std::size_t length);
+    void send_frame(char type, int a, int b, int c, std::uint32_t value);
+    void send_position();
+    bool flush_outgoing();
+};
+
+using NetPlayPtr = osg::ref_ptr<NetPlay>;
@@ -0,0 +1,60 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+
+#include "OSG.h"
+
+// NodeTag -- what a scene node stands for, kept in the node's user data so
+// that picks can identify it without reading (or parsing) its name.  The
+// names are still set, but only as labels for debugging and file dumps.
+
+class NodeTag : public osg::Referenced
+{
+public:
+    enum class Kind : std::uint8_t
+    {
+        Piece,          // index is the piece's id (see Chessboard::Piece::get_id())
+        AttackMarker    // index is the side (see Chessboard::Side)
+    };
+
+public:
+    NodeTag(Kind kind_, int index_) : kind(kind_), index(static_cast<std::int16_t>(index_)) {}
+
+    static void set(osg::Node *node, Kind kind, int index)
+    {
+        node->setUserData(new NodeTag(kind, index));
+    }
+
+    // the tag on a node, if it has one
+    static const NodeTag *get(const osg::Node *node)
+    {
+        return dynamic_cast<const NodeTag *>(node->getUserData());
+    }
+
+    Kind kind;
+    std::int16_t index;
+};
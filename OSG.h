@@ -25,17 +25,32 @@
 //------------------------------------------------------------------------------
 
 #include <osgViewer/Viewer>
+#include <osgViewer/ViewerEventHandlers>
+#include <osg/ArgumentParser>
 #include <osgGA/TrackballManipulator>
 #include <osgGA/TerrainManipulator>
 #include <osgGA/UFOManipulator>
 #include <osg/NodeCallback>
 #include <osg/Camera>
+#include <osg/GraphicsContext>
+#include <osg/Image>
 #include <osg/Group>
 #include <osg/MatrixTransform>
 #include <osg/PositionAttitudeTransform>
+#include <osg/KdTree>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Switch>
+#include <osg/LOD>
+#include <osg/Program>
+#include <osg/Uniform>
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
 #include <osgDB/Registry>
+#include <osgUtil/PolytopeIntersector>
+#include <osgUtil/LineSegmentIntersector>
+#include <osgUtil/RenderBin>
+#include <osgUtil/Simplifier>
 #include <osg/Notify>
 #include <osg/Vec3>
 #include <osg/Quat>
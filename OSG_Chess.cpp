@@ -22,41 +22,342 @@
 // IN THE SOFTWARE.
 //------------------------------------------------------------------------------
 
+#include <ctime>
+#include <chrono>
+#include <functional>
+#include <thread>
+
 #include "Game.h"
 #include "Handlers.h"
+#include "Benchmarks.h"
+#include "GameArchive.h"
+#include "MoveJournal.h"
+#include "NetPlay.h"
+#include "Thumbnails.h"
+#include "Simul.h"
+#include "Profiler.h"
 
-int main(int, char **)
+static void draw_frame(osgViewer::Viewer &viewer)
 {
-    auto game = GamePtr(new Game());
+    {
+        ProfileScope scope(Profiler::Frame);
+        viewer.frame();
+    }
+
+    Profiler::instance().end_frame(viewer.getViewerStats(), viewer.getViewerFrameStamp()->getFrameNumber());
+}
+
+// render only when something has changed: input arrived, a handler asked
+// for a redraw, or the game(s) have motion (or a move) pending.  between
+// frames the loop sleeps, so an untouched board costs next to no CPU.
+
+static void run_on_demand(osgViewer::Viewer &viewer, const std::function<bool()> &needs_frame)
+{
+    const auto idle_sleep = std::chrono::milliseconds(10);
+    const auto report_interval = 10.0; // seconds
+
+    auto timer = osg::Timer::instance();
+    auto report_start = timer->tick();
+    auto cpu_start = std::clock();
+    auto frames = 0;
+
+    while (!viewer.done())
+    {
+        if (viewer.getRequestRedraw() || viewer.getRequestContinousUpdate() || needs_frame() || viewer.checkEvents())
+        {
+            draw_frame(viewer);
+            ++frames;
+        }
+        else
+            std::this_thread::sleep_for(idle_sleep);
+
+        auto elapsed = timer->delta_s(report_start, timer->tick());
+        if (elapsed >= report_interval)
+        {
+            auto cpu = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+            osg::notify(osg::NOTICE) << "On demand: " << frames << " frames in " << elapsed << "s, "
+                                     << (100. * cpu / elapsed) << "% CPU" << std::endl;
+
+            report_start = timer->tick();
+            cpu_start = std::clock();
+            frames = 0;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    // the distances out to which the full and reduced detail meshes are used
+    auto detail_levels = default_detail_levels();
+    if (arguments.read("--no-lod"))
+        detail_levels.resize(1);
+    else
+        arguments.read("--lod-distances", detail_levels[0].max_distance, detail_levels[1].max_distance);
+
+    LodBuilderPtr lod_builder(new LodBuilder(detail_levels));
+
+    auto max_boards = 64;
+    if (arguments.read("--benchmark-boards", max_boards) || arguments.read("--benchmark-boards"))
+        return benchmark_boards(lod_builder, max_boards, 200);
+
+    std::string pgn_file;
+    if (arguments.read("--benchmark-pgn", pgn_file))
+    {
+        auto workers = 0u;
+        arguments.read("--pgn-workers", workers);
+        return benchmark_pgn(pgn_file, workers, arguments.read("--pgn-ordered"));
+    }
+
+    std::string archive_file;
+    if (arguments.read("--convert-pgn", pgn_file, archive_file))
+    {
+        auto workers = 0u;
+        arguments.read("--pgn-workers", workers);
+        return convert_pgn(pgn_file, archive_file, workers);
+    }
+
+    std::string index_file;
+    if (arguments.read("--index-positions", archive_file, index_file))
+    {
+        auto workers = 0u;
+        arguments.read("--pgn-workers", workers);
+        return build_position_index(archive_file, index_file, workers);
+    }
+
+    std::string explorer_table;
+    if (arguments.read("--build-explorer", archive_file, explorer_table))
+    {
+        auto workers = 0u;
+        auto plies = 40;
+        arguments.read("--pgn-workers", workers);
+        arguments.read("--explorer-plies", plies);
+        return build_opening_explorer(archive_file, explorer_table, workers, plies);
+    }
+
+    auto queries = 10000;
+    if (arguments.read("--benchmark-positions", archive_file, index_file))
+    {
+        arguments.read("--queries", queries);
+        return benchmark_positions(archive_file, index_file, queries);
+    }
+
+    auto jumps = 10000;
+    auto history_interval = 16u;
+    arguments.read("--history-interval", history_interval);
+    if (arguments.read("--benchmark-history", archive_file, jumps) || arguments.read("--benchmark-history", archive_file))
+        return benchmark_history(archive_file, jumps, history_interval);
+
+    std::string journal_file;
+    auto journal_games = 1000;
+    if (arguments.read("--benchmark-journal", archive_file, journal_file, journal_games) ||
+        arguments.read("--benchmark-journal", archive_file, journal_file))
+        return benchmark_journal(archive_file, journal_file, journal_games);
+
+    auto archive_games = 100000;
+    if (arguments.read("--benchmark-archive", archive_file, archive_games) || arguments.read("--benchmark-archive", archive_file))
+        return benchmark_archive(archive_file, archive_games);
+
+    auto net_port = 0u;
+    auto net_plies = 200;
+    if (arguments.read("--benchmark-netplay", net_port, net_plies) || arguments.read("--benchmark-netplay", net_port))
+        return benchmark_netplay(static_cast<unsigned short>(net_port), net_plies);
+
+    // a wall of boards to watch, or a single board to play on
+    auto boards = 0;
+    arguments.read("--boards", boards);
+
+    SimulPtr simul;
+    GamePtr game;
+    MoveJournalPtr journal;
+    NetPlayPtr net_play;
+    std::vector<GamePtr> games;
+
+    if (boards > 0)
+    {
+        simul = new Simul(boards, lod_builder);
+        games = simul->get_games();
+    }
+    else
+    {
+        game = new Game(lod_builder);
+        games.push_back(game);
+    }
+
+    // the idle marker spin would keep an on-demand viewer drawing forever
+    auto on_demand = arguments.read("--on-demand");
+    if (on_demand)
+    {
+        for (auto &each_game : games)
+            each_game->set_marker_spin(false);
+    }
+
+    if (game.valid())
+    {
+        auto iterations = 100;
+        if (arguments.read("--benchmark-picking", iterations) || arguments.read("--benchmark-picking"))
+            return benchmark_picking(game, iterations);
+
+        iterations = 1000000;
+        if (arguments.read("--benchmark-fen", iterations) || arguments.read("--benchmark-fen"))
+            return benchmark_fen(game, iterations);
+
+        std::string perft_fen;
+        auto perft_depth = 0;
+        if (arguments.read("--perft", perft_fen, perft_depth))
+            return benchmark_perft(game, perft_fen, perft_depth);
+
+        std::string fen_file, output_dir;
+        if (arguments.read("--thumbnails", fen_file, output_dir))
+        {
+            auto width = 256, height = 256;
+            arguments.read("--thumbnail-size", width, height);
+
+            std::string extension = "png";
+            arguments.read("--thumbnail-format", extension);
+
+            return render_thumbnails(game, fen_file, output_dir, width, height, extension);
+        }
+    }
 
     osgViewer::Viewer viewer;
     viewer.setUpViewInWindow(100, 100, 800, 600);
 
-    auto root = game->get_root_node();
+    // the scene only takes board state from published snapshots, so cull
+    // and draw are free to run on threads of their own
+    std::string threading;
+    if (arguments.read("--threading", threading))
+    {
+        if (threading == "single")
+            viewer.setThreadingModel(osgViewer::ViewerBase::SingleThreaded);
+        else if (threading == "cull-draw")
+            viewer.setThreadingModel(osgViewer::ViewerBase::CullDrawThreadPerContext);
+        else if (threading == "draw")
+            viewer.setThreadingModel(osgViewer::ViewerBase::DrawThreadPerContext);
+        else if (threading == "cull-thread")
+            viewer.setThreadingModel(osgViewer::ViewerBase::CullThreadPerCameraDrawThreadPerContext);
+        else if (threading == "auto")
+            viewer.setThreadingModel(osgViewer::ViewerBase::AutomaticSelection);
+        else
+            osg::notify(osg::WARN) << "Unknown threading model '" << threading << "'; using the default." << std::endl;
+    }
+
+    auto root = simul.valid() ? simul->get_root_node() : game->get_root_node();
     if (!root.valid())
         osg::notify(osg::FATAL) << "Failed in createScene()." << std::endl;
 
     viewer.setSceneData(root.get());
 
-    // add the pick handler
-    viewer.addEventHandler(new SelectionHandler(game->get_board(), root));
+    if (simul.valid())
+    {
+        // the wall is for watching; pan and zoom around it instead of picking
+        osg::Vec3d eye, center, up;
+        simul->get_home_position(eye, center, up);
+
+        osg::ref_ptr<osgGA::TrackballManipulator> manipulator(new osgGA::TrackballManipulator);
+        manipulator->setHomePosition(eye, center, up);
+        viewer.setCameraManipulator(manipulator.get());
+    }
+    else
+    {
+        // add the pick handler
+        osg::ref_ptr<SelectionHandler> selection_handler(new SelectionHandler(game));
+
+        std::string pick_mode;
+        if (arguments.read("--pick-mode", pick_mode))
+        {
+            if (pick_mode == "polytope")
+                selection_handler->set_pick_mode(PickHandlerInterface::PickMode::Polytope);
+            else if (pick_mode == "ray")
+                selection_handler->set_pick_mode(PickHandlerInterface::PickMode::Ray);
+            else if (pick_mode == "kdtree")
+                selection_handler->set_pick_mode(PickHandlerInterface::PickMode::KdTreeRay);
+            else
+                osg::notify(osg::WARN) << "Unknown pick mode '" << pick_mode << "'; using the default." << std::endl;
+        }
 
-    // Set the clear color to something other than chalky blue.
+        viewer.addEventHandler(selection_handler.get());
 
-    viewer.getCamera()->setClearColor(osg::Vec4(1., 1., 1., 1.));
+        GameHistoryPtr history(new GameHistory(game->get_board(), history_interval));
+        viewer.addEventHandler(new HistoryHandler(game, history));
 
-    osg::Matrix lookAt;
-    lookAt.makeLookAt(osg::Vec3(0.5f, -0.5f, 1.f), game->centerScope, osg::Vec3(0.0f, 0.0f, 1.0f));
+        // pick up the game where the journal left off
+        if (arguments.read("--journal", journal_file))
+        {
+            journal = new MoveJournal(game->get_board(), journal_file);
+            journal->restore(history.get());
+        }
+
+        // play against someone at another board
+        auto port = 0u;
+        std::string address;
+        if (arguments.read("--host", port))
+        {
+            net_play = new NetPlay(game);
+            if (net_play->host(static_cast<unsigned short>(port)))
+                selection_handler->set_player_side(net_play->get_side());
+        }
+        else if (arguments.read("--join", address, port))
+        {
+            net_play = new NetPlay(game);
+            if (net_play->join(address, static_cast<unsigned short>(port)))
+                selection_handler->set_player_side(net_play->get_side());
+        }
+
+        std::string position_file;
+        if (arguments.read("--position-index", position_file))
+        {
+            std::shared_ptr<PositionIndex> index(new PositionIndex);
+            if (index->open(position_file))
+                viewer.addEventHandler(new PositionQueryHandler(game, index));
+        }
+
+        std::string explorer_file;
+        if (arguments.read("--explorer", explorer_file))
+        {
+            std::shared_ptr<OpeningExplorer> explorer(new OpeningExplorer);
+            if (explorer->open(explorer_file))
+                viewer.addEventHandler(new ExplorerHandler(game, explorer));
+        }
+
+        viewer.getCamera()->setViewMatrix(game->get_home_view());
+    }
 
-    viewer.getCamera()->setViewMatrix(lookAt);
+    // 's' cycles the stats overlay, which includes our own subsystems
+    osg::ref_ptr<osgViewer::StatsHandler> stats_handler(new osgViewer::StatsHandler);
+    Profiler::instance().add_stats_lines(stats_handler.get());
+    viewer.addEventHandler(stats_handler.get());
+
+    std::string trace_file;
+    auto tracing = arguments.read("--trace", trace_file);
+    if (tracing)
+        Profiler::instance().start_trace();
+
+    // Set the clear color to something other than chalky blue.
+
+    viewer.getCamera()->setClearColor(osg::Vec4(1., 1., 1., 1.));
 
     viewer.realize();
 
-    while (!viewer.done())
+    if (on_demand)
     {
-        // fire off the cull-and-draw traversals of the scene
-        viewer.frame();
+        if (simul.valid())
+            run_on_demand(viewer, [&simul]() { return simul->needs_frame(); });
+        else
+            run_on_demand(viewer, [&game]() { return game->needs_frame(); });
     }
+    else
+    {
+        while (!viewer.done())
+        {
+            // fire off the cull-and-draw traversals of the scene
+            draw_frame(viewer);
+        }
+    }
+
+    if (tracing && !Profiler::instance().write_trace(trace_file))
+        return 1;
 
     return 0;
 }
@@ -0,0 +1,310 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+#include "GameArchive.h"
+#include "LittleEndian.h"
+#include "OpeningExplorer.h"
+
+static const std::uint16_t explorer_version = 1;
+static const std::size_t header_size = 16;
+static const std::size_t entry_size = 22;
+
+static std::uint16_t pack_move(const PgnMove &move)
+{
+    return static_cast<std::uint16_t>(move.from | (move.to << 6) | (static_cast<std::uint32_t>(move.promotion) << 12));
+}
+
+//------------------------------------------------------------------------------
+// OpeningExplorer
+
+bool OpeningExplorer::open(const std::string &path)
+{
+    close();
+
+    if (file.open(path) && file.size() >= header_size && !std::memcmp(file.data(), "OCOE", 4) &&
+        read_le(file.data() + 4, 2) == explorer_version)
+    {
+        entries = read_le(file.data() + 8, 8);
+        if ((file.size() - header_size) / entry_size >= entries)
+            return true;
+    }
+
+    osg::notify(osg::WARN) << "Can't open opening explorer '" << path << "'." << std::endl;
+    close();
+    return false;
+}
+
+void OpeningExplorer::close()
+{
+    file.close();
+    entries = 0;
+}
+
+std::uint64_t OpeningExplorer::key_at(std::uint64_t i) const
+{
+    return read_le(file.data() + header_size + i * entry_size, 8);
+}
+
+std::size_t OpeningExplorer::find(std::uint64_t key, std::vector<ExplorerMove> &moves) const
+{
+    moves.clear();
+
+    std::uint64_t low = 0, high = entries;
+    while (low < high)
+    {
+        auto middle = low + (high - low) / 2;
+        if (key_at(middle) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    for (auto i = low; i < entries && key_at(i) == key; ++i)
+    {
+        auto entry = file.data() + header_size + i * entry_size;
+        auto packed = read_le(entry + 8, 2);
+
+        ExplorerMove move;
+        move.move.from = static_cast<std::uint8_t>(packed & 63);
+        move.move.to = static_cast<std::uint8_t>((packed >> 6) & 63);
+        move.move.promotion = static_cast<Chessboard::Piece::Rank>((packed >> 12) & 7);
+        move.white_wins = static_cast<std::uint32_t>(read_le(entry + 10, 4));
+        move.draws = static_cast<std::uint32_t>(read_le(entry + 14, 4));
+        move.black_wins = static_cast<std::uint32_t>(read_le(entry + 18, 4));
+        moves.push_back(move);
+    }
+
+    std::stable_sort(moves.begin(), moves.end(),
+                     [](const ExplorerMove &a, const ExplorerMove &b) { return a.games() > b.games(); });
+
+    return moves.size();
+}
+
+//------------------------------------------------------------------------------
+// building the table
+
+namespace
+{
+
+struct TallyKey
+{
+    std::uint64_t position;
+    std::uint16_t move;
+
+    bool operator==(const TallyKey &other) const
+    {
+        return position == other.position && move == other.move;
+    }
+    bool operator<(const TallyKey &other) const
+    {
+        return position < other.position || (position == other.position && move < other.move);
+    }
+};
+
+struct TallyKeyHash
+{
+    std::size_t operator()(const TallyKey &key) const
+    {
+        // position keys are already well mixed
+        return static_cast<std::size_t>(key.position ^ (std::uint64_t(key.move) * 0x9e3779b97f4a7c15ull));
+    }
+};
+
+struct Tally
+{
+    std::uint32_t results[3]; // White wins, draws, Black wins
+};
+
+using TallyMap = std::unordered_map<TallyKey, Tally, TallyKeyHash>;
+
+} // namespace
+
+int build_opening_explorer(const std::string &archive_file, const std::string &explorer_file, unsigned int workers,
+                           int max_plies)
+{
+    GameArchive archive;
+    if (!archive.open(archive_file))
+        return 1;
+
+    auto games = archive.size();
+    archive.close();
+
+    if (!workers)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+
+    auto timer = osg::Timer::instance();
+    auto start = timer->tick();
+
+    std::vector<std::unique_ptr<Chessboard>> boards;
+    for (auto i = 0u; i < workers; ++i)
+        boards.emplace_back(new Chessboard(Chessboard::Use::Position));
+
+    std::vector<TallyMap> tallies(workers);
+    std::atomic<bool> failed{false};
+    std::atomic<std::uint64_t> counted{0};
+
+    std::vector<std::thread> threads;
+    for (auto worker = 0u; worker < workers; ++worker)
+    {
+        threads.emplace_back([&, worker] {
+            GameArchive games_archive;
+            if (!games_archive.open(archive_file))
+            {
+                failed = true;
+                return;
+            }
+
+            auto &board = *boards[worker];
+            auto &tally = tallies[worker];
+            PgnGame game;
+
+            auto first = games * worker / workers;
+            auto last = games * (worker + 1) / workers;
+            for (auto n = first; n < last && !failed; ++n)
+            {
+                if (!games_archive.read(n, game))
+                {
+                    failed = true;
+                    break;
+                }
+
+                // unfinished games say nothing about the moves
+                int result;
+                if (!std::strcmp(game.get_result(), "1-0"))
+                    result = 0;
+                else if (!std::strcmp(game.get_result(), "1/2-1/2"))
+                    result = 1;
+                else if (!std::strcmp(game.get_result(), "0-1"))
+                    result = 2;
+                else
+                    continue;
+
+                if (!game.replay(board, 0))
+                    continue;
+
+                const auto &moves = game.get_moves();
+                auto plies = std::min(moves.size(), static_cast<std::size_t>(std::max(max_plies, 0)));
+                for (std::size_t i = 0; i < plies; ++i)
+                {
+                    const auto &move = moves[i];
+
+                    auto &counts = tally[TallyKey{board.position_key(), pack_move(move)}];
+                    ++counts.results[result];
+
+                    board.select(board(move.from / 8, move.from % 8));
+                    if (!board.move_selected_to(move.to / 8, move.to % 8, move.promotion))
+                        break;
+                }
+
+                ++counted;
+            }
+        });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    if (failed)
+    {
+        osg::notify(osg::WARN) << "Failed reading game archive '" << archive_file << "'." << std::endl;
+        return 1;
+    }
+
+    // fold the workers' tables into the largest, then sort it for writing
+
+    auto &merged = *std::max_element(tallies.begin(), tallies.end(),
+                                     [](const TallyMap &a, const TallyMap &b) { return a.size() < b.size(); });
+    for (auto &tally : tallies)
+    {
+        if (&tally == &merged)
+            continue;
+
+        for (const auto &entry : tally)
+        {
+            auto &counts = merged[entry.first];
+            for (auto i = 0; i < 3; ++i)
+                counts.results[i] += entry.second.results[i];
+        }
+        TallyMap().swap(tally);
+    }
+
+    std::vector<std::pair<TallyKey, Tally>> sorted(merged.begin(), merged.end());
+    TallyMap().swap(merged);
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<TallyKey, Tally> &a, const std::pair<TallyKey, Tally> &b) { return a.first < b.first; });
+
+    auto output = std::fopen(explorer_file.c_str(), "wb");
+    if (!output)
+    {
+        osg::notify(osg::WARN) << "Can't create opening explorer '" << explorer_file << "'." << std::endl;
+        return 1;
+    }
+
+    unsigned char header[header_size] = {'O', 'C', 'O', 'E'};
+    write_le(header + 4, explorer_version, 2);
+    write_le(header + 8, sorted.size(), 8);
+    auto written = std::fwrite(header, 1, header_size, output) == header_size;
+
+    std::vector<unsigned char> buffer;
+    buffer.reserve(entry_size * 65536);
+    for (std::size_t i = 0; i < sorted.size() && written; ++i)
+    {
+        unsigned char entry[entry_size];
+        write_le(entry, sorted[i].first.position, 8);
+        write_le(entry + 8, sorted[i].first.move, 2);
+        for (auto r = 0; r < 3; ++r)
+            write_le(entry + 10 + r * 4, sorted[i].second.results[r], 4);
+        buffer.insert(buffer.end(), entry, entry + entry_size);
+
+        if (buffer.size() + entry_size > buffer.capacity() || i + 1 == sorted.size())
+        {
+            written = std::fwrite(buffer.data(), 1, buffer.size(), output) == buffer.size();
+            buffer.clear();
+        }
+    }
+
+    if (std::fclose(output) || !written)
+    {
+        osg::notify(osg::WARN) << "Failed writing opening explorer '" << explorer_file << "'." << std::endl;
+        return 1;
+    }
+
+    auto elapsed = timer->delta_s(start, timer->tick());
+    std::cout << counted << " finished games of " << games << " tallied to " << max_plies << " plies: " << sorted.size()
+              << " position/move entries in " << std::fixed << std::setprecision(2) << elapsed << " s on " << workers
+              << " workers; table is " << ((header_size + sorted.size() * entry_size) / (1024. * 1024.)) << " MB"
+              << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Chessboard.h"
+#include "MappedFile.h"
+#include "Pgn.h"
+
+// OpeningExplorer -- for a position, the moves archived games played from
+// it, and how those games ended.  The table is built once from an archive
+// (see GameArchive) and searched in place.  Its file is a 16-byte header
+// ("OCOE", a u16 version, two spare bytes and a u64 entry count), then
+// 22-byte entries sorted by position and then move: a u64 position key
+// (Chessboard::position_key()), a u16 move (packed as in GameArchive),
+// and u32 counts of White wins, draws and Black wins.
+
+struct ExplorerMove
+{
+    PgnMove move;
+    std::uint32_t white_wins;
+    std::uint32_t draws;
+    std::uint32_t black_wins;
+
+    std::uint32_t games() const
+    {
+        return white_wins + draws + black_wins;
+    }
+};
+
+class OpeningExplorer
+{
+public:
+    bool open(const std::string &path);
+    void close();
+
+    std::uint64_t size() const
+    {
+        return entries;
+    }
+
+    // the moves played from the position, most played first
+    std::size_t find(std::uint64_t key, std::vector<ExplorerMove> &moves) const;
+    std::size_t find(const Chessboard &board, std::vector<ExplorerMove> &moves) const
+    {
+        return find(board.position_key(), moves);
+    }
+
+protected:
+    std::uint64_t key_at(std::uint64_t i) const;
+
+    MappedFile file;
+    std::uint64_t entries{0};
+};
+
+// tally the first max_plies moves of every finished game in an archive, on
+// the given number of workers (0 for one per core), each into a table of
+// its own; the tables are merged at the end
+int build_opening_explorer(const std::string &archive_file, const std::string &explorer_file, unsigned int workers,
+                           int max_plies);
@@ -0,0 +1,624 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+
+#include "Pgn.h"
+
+static bool is_space(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\f' || ch == '\v';
+}
+
+static bool is_digit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+// the characters of a PGN "symbol" token (plus '/', for "1/2-1/2")
+static bool is_symbol(char ch)
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || is_digit(ch) || ch == '_' || ch == '+' ||
+           ch == '#' || ch == '=' || ch == ':' || ch == '-' || ch == '/';
+}
+
+static bool matches(const char *token, std::size_t length, const char *text)
+{
+    return std::strlen(text) == length && !std::memcmp(token, text, length);
+}
+
+static void skip_past(const char *&p, const char *end, char ch)
+{
+    while (p < end && *p++ != ch)
+        ;
+}
+
+static Chessboard::Piece::Rank piece_letter(char ch)
+{
+    switch (ch)
+    {
+        case 'N': return Chessboard::Piece::Rank::Knight;
+        case 'B': return Chessboard::Piece::Rank::Bishop;
+        case 'R': return Chessboard::Piece::Rank::Rook;
+        case 'Q': return Chessboard::Piece::Rank::Queen;
+        case 'K': return Chessboard::Piece::Rank::King;
+        default: return Chessboard::Piece::Rank::Empty;
+    }
+}
+
+//------------------------------------------------------------------------------
+// PgnGame
+
+void PgnGame::clear()
+{
+    // (keeping the vectors' capacity for the next game)
+    text.clear();
+    tags.clear();
+    moves.clear();
+    result = "*";
+    error = nullptr;
+    offset = 0;
+}
+
+bool PgnGame::get_tag(const char *name, const char *&value, std::size_t &length) const
+{
+    auto name_length = std::strlen(name);
+    for (const auto &tag : tags)
+    {
+        if (tag.name_length == name_length && !std::memcmp(&text[tag.name], name, name_length))
+        {
+            value = text.data() + tag.value;
+            length = tag.value_length;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string PgnGame::get_tag(const char *name) const
+{
+    const char *value;
+    std::size_t length;
+    if (!get_tag(name, value, length))
+        return std::string();
+    return std::string(value, length);
+}
+
+void PgnGame::get_tag(std::size_t i, const char *&name, std::size_t &name_length, const char *&value,
+                      std::size_t &value_length) const
+{
+    const auto &tag = tags[i];
+    name = text.data() + tag.name;
+    name_length = tag.name_length;
+    value = text.data() + tag.value;
+    value_length = tag.value_length;
+}
+
+bool PgnGame::replay(Chessboard &board, std::size_t plies) const
+{
+    const char *fen;
+    std::size_t fen_length;
+    if (!get_tag("FEN", fen, fen_length))
+        board.reset();
+    else if (!board.set_fen(fen, fen_length))
+        return false;
+
+    plies = std::min(plies, moves.size());
+    for (std::size_t i = 0; i < plies; ++i)
+    {
+        const auto &move = moves[i];
+        board.select(board(move.from / 8, move.from % 8));
+        if (!board.move_selected_to(move.to / 8, move.to % 8, move.promotion))
+            return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// PgnParser
+
+bool PgnParser::parse(const char *text, std::size_t length, std::uint64_t offset, PgnGame &game)
+{
+    game.clear();
+    game.offset = offset;
+
+    auto p = text;
+    auto end = text + length;
+
+    // the tag pairs
+
+    for (;;)
+    {
+        while (p < end && is_space(*p))
+            ++p;
+
+        if (p < end && *p == '%')
+            skip_past(p, end, '\n');
+        else if (p < end && *p == '[')
+        {
+            if (!read_tag(p, end, game) && !game.error)
+                game.error = "malformed tag";
+        }
+        else
+            break;
+    }
+
+    if (p == end && game.tags.empty())
+        return false;
+
+    // the starting position
+
+    const char *fen;
+    std::size_t fen_length;
+    if (!game.get_tag("FEN", fen, fen_length))
+        board.reset();
+    else if (!board.set_fen(fen, fen_length) && !game.error)
+        game.error = "bad FEN";
+
+    // the movetext: move numbers, SAN moves and the result, with comments,
+    // variations and annotations to skip over
+
+    while (p < end)
+    {
+        auto ch = *p;
+        if (is_space(ch) || ch == '.' || ch == '!' || ch == '?')
+        {
+            ++p;
+            continue;
+        }
+
+        if (ch == '{')
+        {
+            skip_past(p, end, '}');
+            continue;
+        }
+
+        if (ch == ';' || ch == '%')
+        {
+            skip_past(p, end, '\n');
+            continue;
+        }
+
+        if (ch == '(')
+        {
+            // variations nest, and may hold comments of their own
+            auto depth = 0;
+            while (p < end)
+            {
+                ch = *p++;
+                if (ch == '(')
+                    ++depth;
+                else if (ch == ')' && !--depth)
+                    break;
+                else if (ch == '{')
+                    skip_past(p, end, '}');
+                else if (ch == ';')
+                    skip_past(p, end, '\n');
+            }
+            continue;
+        }
+
+        if (ch == '$')
+        {
+            // a numeric annotation glyph
+            for (++p; p < end && is_digit(*p); ++p)
+                ;
+            continue;
+        }
+
+        if (ch == '*')
+        {
+            game.result = "*";
+            break;
+        }
+
+        auto token = p;
+        while (p < end && is_symbol(*p))
+            ++p;
+
+        auto token_length = static_cast<std::size_t>(p - token);
+        if (!token_length)
+        {
+            ++p; // something stray
+            continue;
+        }
+
+        if (matches(token, token_length, "1-0"))
+        {
+            game.result = "1-0";
+            break;
+        }
+        if (matches(token, token_length, "0-1"))
+        {
+            game.result = "0-1";
+            break;
+        }
+        if (matches(token, token_length, "1/2-1/2"))
+        {
+            game.result = "1/2-1/2";
+            break;
+        }
+
+        // a move number ("12" of "12." or "12...")
+        auto number = true;
+        for (auto i = 0u; number && i < token_length; ++i)
+            number = is_digit(token[i]);
+        if (number)
+            continue;
+
+        // once a move fails, the rest can't be placed; but read on for the
+        // result
+        if (!game.error)
+            game.error = play_san(token, token_length, game);
+    }
+
+    return true;
+}
+
+// [Name "value"], with '\' escaping '"' and '\' in the value
+
+bool PgnParser::read_tag(const char *&p, const char *end, PgnGame &game)
+{
+    ++p;
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+
+    auto name = p;
+    while (p < end && is_symbol(*p))
+        ++p;
+    auto name_length = static_cast<std::size_t>(p - name);
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+
+    if (!name_length || p == end || *p != '"')
+    {
+        skip_past(p, end, '\n');
+        return false;
+    }
+    ++p;
+
+    PgnGame::Tag tag;
+    tag.name = static_cast<std::uint32_t>(game.text.size());
+    tag.name_length = static_cast<std::uint32_t>(name_length);
+    game.text.insert(game.text.end(), name, name + name_length);
+
+    tag.value = static_cast<std::uint32_t>(game.text.size());
+    for (; p < end && *p != '"' && *p != '\n'; ++p)
+    {
+        if (*p == '\\' && p + 1 < end)
+            ++p;
+        game.text.push_back(*p);
+    }
+    tag.value_length = static_cast<std::uint32_t>(game.text.size() - tag.value);
+
+    if (p == end || *p != '"')
+    {
+        skip_past(p, end, '\n');
+        return false;
+    }
+
+    while (p < end && *p != ']' && *p != '\n')
+        ++p;
+    if (p < end && *p == ']')
+        ++p;
+
+    game.tags.push_back(tag);
+    return true;
+}
+
+// find the one piece of the side to move that the SAN move can mean, and
+// play it; returns what's wrong with the move, if anything
+
+const char *PgnParser::play_san(const char *san, std::size_t length, PgnGame &game)
+{
+    // check and mate markers add nothing
+    while (length && (san[length - 1] == '+' || san[length - 1] == '#'))
+        --length;
+
+    auto side = board.local_side();
+    auto home = (side == Chessboard::White) ? 0 : 7;
+
+    auto rank = Chessboard::Piece::Rank::Pawn;
+    auto promotion = Chessboard::Piece::Rank::Empty;
+    int from_row = -1, from_col = -1, to_row, to_col;
+
+    if (matches(san, length, "O-O") || matches(san, length, "0-0"))
+    {
+        rank = Chessboard::Piece::Rank::King;
+        from_row = to_row = home;
+        from_col = 4;
+        to_col = 6;
+    }
+    else if (matches(san, length, "O-O-O") || matches(san, length, "0-0-0"))
+    {
+        rank = Chessboard::Piece::Rank::King;
+        from_row = to_row = home;
+        from_col = 4;
+        to_col = 2;
+    }
+    else
+    {
+        auto p = san;
+        auto end = san + length;
+
+        if (p < end && piece_letter(*p) != Chessboard::Piece::Rank::Empty)
+            rank = piece_letter(*p++);
+
+        // a promotion: "e8=Q", or the older "e8Q"
+        if (end - p >= 3 && end[-2] == '=')
+        {
+            promotion = piece_letter(end[-1]);
+            end -= 2;
+        }
+        else if (end - p >= 3 && end[-2] >= '1' && end[-2] <= '8' && piece_letter(end[-1]) != Chessboard::Piece::Rank::Empty)
+            promotion = piece_letter(*--end);
+
+        if (end - p < 2)
+            return "unreadable move";
+
+        to_col = end[-2] - 'a';
+        to_row = end[-1] - '1';
+        if (to_col < 0 || to_col > 7 || to_row < 0 || to_row > 7)
+            return "unreadable move";
+        end -= 2;
+
+        // what's left says where the piece comes from (as much as is needed
+        // to tell it apart), and whether it captures
+        for (; p < end; ++p)
+        {
+            if (*p >= 'a' && *p <= 'h')
+                from_col = *p - 'a';
+            else if (*p >= '1' && *p <= '8')
+                from_row = *p - '1';
+            else if (*p != 'x' && *p != ':')
+                return "unreadable move";
+        }
+
+        auto promoting = (rank == Chessboard::Piece::Rank::Pawn && (to_row == 0 || to_row == 7));
+        if (promoting != (promotion != Chessboard::Piece::Rank::Empty) || promotion == Chessboard::Piece::Rank::King)
+            return "bad promotion";
+    }
+
+    auto found = 0;
+    int found_row = -1, found_col = -1;
+    for (auto row = 0; row < 8; ++row)
+    {
+        if (from_row >= 0 && row != from_row)
+            continue;
+
+        for (auto col = 0; col < 8; ++col)
+        {
+            if (from_col >= 0 && col != from_col)
+                continue;
+
+            const auto &piece = board(row, col).piece;
+            if (piece.get_rank() != rank || piece.get_side() != side)
+                continue;
+
+            if (!board.is_legal(row, col, to_row, to_col))
+                continue;
+
+            if (found++)
+                return "ambiguous move";
+            found_row = row;
+            found_col = col;
+        }
+    }
+
+    if (!found)
+        return "illegal move";
+
+    board.select(board(found_row, found_col));
+    board.move_selected_to(to_row, to_col, promotion);
+
+    PgnMove move;
+    move.from = static_cast<std::uint8_t>(found_row * 8 + found_col);
+    move.to = static_cast<std::uint8_t>(to_row * 8 + to_col);
+    move.promotion = promotion;
+    game.moves.push_back(move);
+
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+// PgnReader
+
+PgnReader::PgnReader(std::size_t chunk_size) : buffer(chunk_size ? chunk_size : 1) {}
+
+PgnReader::~PgnReader()
+{
+    close();
+}
+
+bool PgnReader::open(const std::string &path)
+{
+    close();
+
+    file = std::fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        osg::notify(osg::WARN) << "Can't open PGN file '" << path << "'." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void PgnReader::close()
+{
+    if (file)
+        std::fclose(file);
+
+    file = nullptr;
+    begin = end = 0;
+    file_offset = 0;
+    at_eof = false;
+}
+
+// read more of the file in behind the unread text; false at the end of it
+
+bool PgnReader::fill()
+{
+    if (!file || at_eof)
+        return false;
+
+    if (begin)
+    {
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+    }
+
+    // a game longer than the buffer
+    if (end == buffer.size())
+        buffer.resize(buffer.size() * 2);
+
+    auto count = std::fread(buffer.data() + end, 1, buffer.size() - end, file);
+    if (!count)
+    {
+        at_eof = true;
+        return false;
+    }
+
+    end += count;
+    file_offset += count;
+    return true;
+}
+
+// a game runs until the next one's tags start (a '[' opening a line after
+// its movetext, outside of any comment), or to the end of the file
+
+bool PgnReader::next_text(const char *&text, std::size_t &length, std::uint64_t &offset)
+{
+    for (;;)
+    {
+        while (begin < end && is_space(buffer[begin]))
+            ++begin;
+        if (begin < end)
+            break;
+        if (!fill())
+            return false;
+    }
+
+    offset = file_offset - (end - begin);
+
+    enum
+    {
+        Normal,
+        Comment,    // {...}
+        Line        // a tag pair, a ';' comment or a '%' escape, to the end of the line
+    } state = Normal;
+
+    auto in_movetext = false;
+    auto line_start = true;
+
+    std::size_t pos = 0; // from begin, which fill() moves
+    for (;; ++pos)
+    {
+        if (begin + pos == end && !fill())
+            break;
+
+        auto ch = buffer[begin + pos];
+        switch (state)
+        {
+            case Comment:
+                if (ch == '}')
+                    state = Normal;
+                break;
+
+            case Line:
+                if (ch == '\n')
+                    state = Normal;
+                break;
+
+            case Normal:
+                if (line_start && ch == '[')
+                {
+                    if (in_movetext)
+                    {
+                        text = buffer.data() + begin;
+                        length = pos;
+                        begin += pos;
+                        return true;
+                    }
+                    state = Line;
+                }
+                else if (line_start && ch == '%')
+                    state = Line;
+                else if (ch == '{')
+                {
+                    state = Comment;
+                    in_movetext = true;
+                }
+                else if (ch == ';')
+                {
+                    state = Line;
+                    in_movetext = true;
+                }
+                else if (!is_space(ch))
+                    in_movetext = true;
+                break;
+        }
+
+        line_start = (ch == '\n');
+    }
+
+    text = buffer.data() + begin;
+    length = pos;
+    begin += pos;
+    return true;
+}
+
+bool PgnReader::next(PgnGame &game)
+{
+    const char *text;
+    std::size_t length;
+    std::uint64_t offset;
+
+    while (next_text(text, length, offset))
+    {
+        if (parser.parse(text, length, offset, game))
+            return true;
+    }
+
+    return false;
+}
+
+std::size_t PgnReader::read(const std::function<bool(const PgnGame &)> &visit)
+{
+    PgnGame game;
+    std::size_t count = 0;
+    while (next(game))
+    {
+        ++count;
+        if (!visit(game))
+            break;
+    }
+
+    return count;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Chessboard.h"
+
+// PGN -- reading games from Portable Game Notation files.  A PgnReader
+// streams a file through a fixed-size buffer, one game's text at a time,
+// and a PgnParser turns that text into a PgnGame, resolving each SAN move
+// against a Chessboard's legal moves.  Tokens are read in place, and the
+// PgnGame passed in is reused from one game to the next, so reading a game
+// allocates nothing once the buffers have grown to fit.
+
+// a move, as played on the board: cells are row * 8 + col
+struct PgnMove
+{
+    std::uint8_t from;
+    std::uint8_t to;
+    Chessboard::Piece::Rank promotion;  // Empty, unless a pawn promotes
+};
+
+class PgnGame
+{
+public:
+    // the value of a tag (e.g., "White"), or false if the game hasn't got it
+    bool get_tag(const char *name, const char *&value, std::size_t &length) const;
+    std::string get_tag(const char *name) const;
+
+    std::size_t get_tag_count() const
+    {
+        return tags.size();
+    }
+    void get_tag(std::size_t i, const char *&name, std::size_t &name_length, const char *&value,
+                 std::size_t &value_length) const;
+
+    // the moves, up to any error
+    const std::vector<PgnMove> &get_moves() const
+    {
+        return moves;
+    }
+
+    // "1-0", "0-1", "1/2-1/2" or "*"
+    const char *get_result() const
+    {
+        return result;
+    }
+
+    // the reason the game couldn't be read in full, or nullptr
+    const char *get_error() const
+    {
+        return error;
+    }
+    // the ply (counting from 0) at which an illegal or unreadable move was met
+    std::size_t get_error_ply() const
+    {
+        return moves.size();
+    }
+
+    // where the game's text starts in its file
+    std::uint64_t get_offset() const
+    {
+        return offset;
+    }
+
+    void clear();
+
+    // set the board to the game's start position (its FEN tag, if it has
+    // one) and play the first plies moves on it, without checking them
+    bool replay(Chessboard &board, std::size_t plies = SIZE_MAX) const;
+
+protected:
+    friend class PgnParser;
+    friend class GameArchive;
+
+    struct Tag
+    {
+        std::uint32_t name;     // offsets into text
+        std::uint32_t name_length;
+        std::uint32_t value;
+        std::uint32_t value_length;
+    };
+
+    std::vector<char> text;     // the tag names and (unescaped) values
+    std::vector<Tag> tags;
+    std::vector<PgnMove> moves;
+    const char *result{"*"};
+    const char *error{nullptr};
+    std::uint64_t offset{0};
+};
+
+// PgnParser -- reads a single game's text.  Each parser has its own
+// board, so separate threads can use separate parsers.
+
+class PgnParser
+{
+public:
+    // returns false if the text held no game at all; a game with a bad
+    // move (or start position) is returned with its error set
+    bool parse(const char *text, std::size_t length, std::uint64_t offset, PgnGame &game);
+
+protected:
+    bool read_tag(const char *&p, const char *end, PgnGame &game);
+    const char *play_san(const char *san, std::size_t length, PgnGame &game);
+
+    Chessboard board{Chessboard::Use::Position};
+};
+
+// PgnReader -- splits a file into games' text.  The buffer only ever
+// needs to hold a game at a time, so memory stays bounded however big the
+// file is; it grows past chunk_size only for a game longer than that.
+
+class PgnReader
+{
+public:
+    explicit PgnReader(std::size_t chunk_size = 1 << 20);
+    ~PgnReader();
+
+    bool open(const std::string &path);
+    void close();
+
+    // the text of the next game, valid until the next call; false at the
+    // end of the file
+    bool next_text(const char *&text, std::size_t &length, std::uint64_t &offset);
+
+    // the next game, parsed
+    bool next(PgnGame &game);
+
+    // calls visit with each game until the end of the file, or until it
+    // returns false; returns the number of games visited
+    std::size_t read(const std::function<bool(const PgnGame &)> &visit);
+
+    // bytes consumed from the file so far
+    std::uint64_t get_bytes_read() const
+    {
+        return file_offset;
+    }
+
+protected:
+    bool fill();
+
+    std::FILE *file{nullptr};
+    std::vector<char> buffer;
+    std::size_t begin{0};       // the unread part of buffer is [begin, end)
+    std::size_t end{0};
+    std::uint64_t file_offset{0};   // of buffer[end]
+    bool at_eof{false};
+
+    PgnParser parser;
+};
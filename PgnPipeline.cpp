@@ -0,0 +1,259 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PgnPipeline.h"
+
+namespace
+{
+
+// a batch of games: their text as read, then as parsed
+struct Batch
+{
+    struct Span
+    {
+        std::size_t start;
+        std::size_t length;
+        std::uint64_t offset;
+    };
+
+    std::uint64_t sequence{0};
+    std::vector<char> text;
+    std::vector<Span> spans;
+    std::vector<PgnGame> games;     // kept between uses, along with their buffers
+    std::size_t parsed{0};
+
+    void clear()
+    {
+        text.clear();
+        spans.clear();
+        parsed = 0;
+    }
+};
+
+// a blocking queue; once closed, pop() drains what's left and then fails
+class BatchQueue
+{
+public:
+    void push(Batch *batch)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            batches.push_back(batch);
+        }
+        ready.notify_one();
+    }
+
+    bool pop(Batch *&batch)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        ready.wait(guard, [this] { return closed || !batches.empty(); });
+        if (batches.empty())
+            return false;
+
+        batch = batches.front();
+        batches.pop_front();
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+        }
+        ready.notify_all();
+    }
+
+private:
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<Batch *> batches;
+    bool closed{false};
+};
+
+} // namespace
+
+PgnPipeline::PgnPipeline(unsigned int workers_, bool ordered_) : workers(workers_), ordered(ordered_)
+{
+    if (!workers)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+}
+
+void PgnPipeline::set_batching(std::size_t games_per_batch_, std::size_t batches_)
+{
+    games_per_batch = std::max<std::size_t>(1, games_per_batch_);
+    batches = batches_;
+}
+
+bool PgnPipeline::run(const std::string &path, const std::function<bool(const PgnGame &)> &sink, Report &report)
+{
+    report = Report();
+
+    PgnReader reader;
+    if (!reader.open(path))
+        return false;
+
+    auto timer = osg::Timer::instance();
+    auto start = timer->tick();
+
+    // the batches to go around: the reader waits on free ones, the workers
+    // on full ones, and this thread on parsed ones
+
+    std::vector<std::unique_ptr<Batch>> pool;
+    BatchQueue free_batches, full_batches, parsed_batches;
+
+    auto batch_count = batches ? batches : std::size_t(workers) * 4;
+    for (std::size_t i = 0; i < batch_count; ++i)
+    {
+        pool.emplace_back(new Batch);
+        free_batches.push(pool.back().get());
+    }
+
+    std::atomic<bool> stopping{false};
+
+    std::thread read_thread([&] {
+        const char *text;
+        std::size_t length;
+        std::uint64_t offset;
+
+        std::uint64_t sequence = 0;
+        auto more = true;
+
+        Batch *batch;
+        while (more && !stopping && free_batches.pop(batch))
+        {
+            batch->clear();
+            batch->sequence = sequence++;
+
+            while (batch->spans.size() < games_per_batch && (more = reader.next_text(text, length, offset)))
+            {
+                batch->spans.push_back(Batch::Span{batch->text.size(), length, offset});
+                batch->text.insert(batch->text.end(), text, text + length);
+            }
+
+            if (batch->spans.empty())
+                break;
+            full_batches.push(batch);
+        }
+
+        full_batches.close();
+    });
+
+    std::vector<std::unique_ptr<PgnParser>> parsers;
+    for (auto i = 0u; i < workers; ++i)
+        parsers.emplace_back(new PgnParser);
+
+    std::atomic<unsigned int> working{workers};
+    std::vector<std::thread> work_threads;
+    for (auto i = 0u; i < workers; ++i)
+    {
+        work_threads.emplace_back([&, i] {
+            auto &parser = *parsers[i];
+
+            Batch *batch;
+            while (full_batches.pop(batch))
+            {
+                if (batch->games.size() < batch->spans.size())
+                    batch->games.resize(batch->spans.size());
+
+                if (!stopping)
+                {
+                    for (const auto &span : batch->spans)
+                    {
+                        if (parser.parse(batch->text.data() + span.start, span.length, span.offset, batch->games[batch->parsed]))
+                            ++batch->parsed;
+                    }
+                }
+
+                parsed_batches.push(batch);
+            }
+
+            if (!--working)
+                parsed_batches.close();
+        });
+    }
+
+    // hand the games to the sink, holding back any that come in ahead of
+    // their turn if they're wanted in order
+
+    std::map<std::uint64_t, Batch *> waiting;
+    std::uint64_t next_sequence = 0;
+
+    auto deliver = [&](Batch *batch) {
+        for (std::size_t i = 0; i < batch->parsed && !stopping; ++i)
+        {
+            const auto &game = batch->games[i];
+
+            ++report.games;
+            report.plies += game.get_moves().size();
+            if (game.get_error())
+                ++report.bad_games;
+
+            if (!sink(game))
+            {
+                // let the reader go; the workers drain what's already read
+                stopping = true;
+                free_batches.close();
+            }
+        }
+
+        free_batches.push(batch);
+    };
+
+    Batch *batch;
+    while (parsed_batches.pop(batch))
+    {
+        if (!ordered)
+        {
+            deliver(batch);
+            continue;
+        }
+
+        waiting[batch->sequence] = batch;
+        for (auto next = waiting.find(next_sequence); next != waiting.end(); next = waiting.find(++next_sequence))
+        {
+            deliver(next->second);
+            waiting.erase(next);
+        }
+    }
+
+    read_thread.join();
+    for (auto &thread : work_threads)
+        thread.join();
+
+    report.bytes = reader.get_bytes_read();
+    report.seconds = timer->delta_s(start, timer->tick());
+
+    return true;
+}
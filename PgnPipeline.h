@@ -0,0 +1,75 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "Pgn.h"
+
+// PgnPipeline -- reads a PGN file on all cores.  A reader thread splits the
+// file into batches of games' text, a pool of workers parses and replays
+// each batch on boards of their own, and the calling thread hands the
+// games to a sink.  There are only ever so many batches, so a slow sink
+// (or slow workers) holds the reader back, rather than the file piling up
+// in memory.
+
+class PgnPipeline
+{
+public:
+    struct Report
+    {
+        std::size_t games{0};
+        std::size_t plies{0};
+        std::size_t bad_games{0};   // with an illegal or unreadable move
+        std::uint64_t bytes{0};
+        double seconds{0.};
+    };
+
+public:
+    // workers: 0 for one per core.  ordered: hand games to the sink in file
+    // order, rather than as they're finished.
+    explicit PgnPipeline(unsigned int workers = 0, bool ordered = false);
+
+    // games per batch, and the number of batches in flight at once (0 for
+    // four per worker)
+    void set_batching(std::size_t games_per_batch, std::size_t batches);
+
+    unsigned int get_workers() const
+    {
+        return workers;
+    }
+
+    // read the file, calling sink with each game (on this thread, one game
+    // at a time) until the end of the file, or until sink returns false
+    bool run(const std::string &path, const std::function<bool(const PgnGame &)> &sink, Report &report);
+
+protected:
+    unsigned int workers;
+    bool ordered;
+    std::size_t games_per_batch{256};
+    std::size_t batches{0};
+};
@@ -0,0 +1,397 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include "GameArchive.h"
+#include "LittleEndian.h"
+#include "PositionIndex.h"
+
+static const std::uint16_t index_version = 1;
+static const std::size_t header_size = 16;
+static const std::size_t entry_size = 12;
+
+// entries each worker sorts in memory before writing them out as a run
+static const std::size_t run_entries = 1 << 22;
+
+//------------------------------------------------------------------------------
+// PositionIndex
+
+PositionIndex::~PositionIndex()
+{
+    close();
+}
+
+bool PositionIndex::open(const std::string &path)
+{
+    close();
+
+    if (file.open(path) && file.size() >= header_size && !std::memcmp(file.data(), "OCPI", 4) &&
+        read_le(file.data() + 4, 2) == index_version)
+    {
+        entries = read_le(file.data() + 8, 8);
+        if ((file.size() - header_size) / entry_size >= entries)
+            return true;
+    }
+
+    osg::notify(osg::WARN) << "Can't open position index '" << path << "'." << std::endl;
+    close();
+    return false;
+}
+
+void PositionIndex::close()
+{
+    file.close();
+    entries = 0;
+}
+
+std::uint64_t PositionIndex::key_at(std::uint64_t i) const
+{
+    return read_le(file.data() + header_size + i * entry_size, 8);
+}
+
+std::uint32_t PositionIndex::game_at(std::uint64_t i) const
+{
+    return static_cast<std::uint32_t>(read_le(file.data() + header_size + i * entry_size + 8, 4));
+}
+
+std::size_t PositionIndex::find(std::uint64_t key, std::vector<std::uint32_t> &games, std::size_t limit) const
+{
+    games.clear();
+
+    // two binary searches bound the key's entries, so counting the games
+    // doesn't mean visiting them (the start position is in every game)
+
+    std::uint64_t low = 0, high = entries;
+    while (low < high)
+    {
+        auto middle = low + (high - low) / 2;
+        if (key_at(middle) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    auto first = low;
+    high = entries;
+    while (low < high)
+    {
+        auto middle = low + (high - low) / 2;
+        if (key_at(middle) <= key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    for (auto i = first; i < low && games.size() < limit; ++i)
+        games.push_back(game_at(i));
+
+    return static_cast<std::size_t>(low - first);
+}
+
+//------------------------------------------------------------------------------
+// building an index
+
+namespace
+{
+
+struct Entry
+{
+    std::uint64_t key;
+    std::uint32_t game;
+
+    bool operator<(const Entry &other) const
+    {
+        return key < other.key || (key == other.key && game < other.game);
+    }
+    bool operator==(const Entry &other) const
+    {
+        return key == other.key && game == other.game;
+    }
+};
+
+// entries go out through a buffer of their packed form
+class EntryWriter
+{
+public:
+    explicit EntryWriter(std::FILE *file_) : file(file_)
+    {
+        buffer.reserve(entry_size * 65536);
+    }
+
+    bool put(const Entry &entry)
+    {
+        if (buffer.size() + entry_size > buffer.capacity())
+        {
+            if (!flush())
+                return false;
+        }
+
+        unsigned char packed[entry_size];
+        write_le(packed, entry.key, 8);
+        write_le(packed + 8, entry.game, 4);
+        buffer.insert(buffer.end(), packed, packed + entry_size);
+        ++count;
+        return true;
+    }
+
+    bool flush()
+    {
+        auto written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        buffer.clear();
+        return written;
+    }
+
+    std::uint64_t count{0};
+
+private:
+    std::FILE *file;
+    std::vector<unsigned char> buffer;
+};
+
+class RunReader
+{
+public:
+    explicit RunReader(std::FILE *file_) : file(file_) {}
+    ~RunReader()
+    {
+        std::fclose(file);
+    }
+
+    bool next()
+    {
+        unsigned char packed[entry_size];
+        if (std::fread(packed, 1, entry_size, file) != entry_size)
+            return false;
+
+        current.key = read_le(packed, 8);
+        current.game = static_cast<std::uint32_t>(read_le(packed + 8, 4));
+        return true;
+    }
+
+    Entry current;
+
+private:
+    std::FILE *file;
+};
+
+} // namespace
+
+int build_position_index(const std::string &archive_file, const std::string &index_file, unsigned int workers)
+{
+    GameArchive archive;
+    if (!archive.open(archive_file))
+        return 1;
+
+    auto games = archive.size();
+    archive.close();
+
+    if (games > 0xffffffffull)
+    {
+        osg::notify(osg::WARN) << "Too many games to index in '" << archive_file << "'." << std::endl;
+        return 1;
+    }
+
+    if (!workers)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+
+    auto timer = osg::Timer::instance();
+    auto start = timer->tick();
+
+    std::vector<std::unique_ptr<Chessboard>> boards;
+    for (auto i = 0u; i < workers; ++i)
+        boards.emplace_back(new Chessboard(Chessboard::Use::Position));
+
+    std::mutex runs_lock;
+    std::vector<std::string> runs;
+    std::atomic<bool> failed{false};
+    std::atomic<std::uint64_t> positions{0};
+
+    // sort what's been gathered, and write it out as a run
+    auto write_run = [&](std::vector<Entry> &entries) {
+        if (entries.empty())
+            return;
+
+        std::sort(entries.begin(), entries.end());
+        entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+        std::string path;
+        {
+            std::lock_guard<std::mutex> guard(runs_lock);
+            path = index_file + ".run" + std::to_string(runs.size());
+            runs.push_back(path);
+        }
+
+        auto file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            failed = true;
+            return;
+        }
+
+        EntryWriter writer(file);
+        for (const auto &entry : entries)
+            writer.put(entry);
+        if (!writer.flush())
+            failed = true;
+        std::fclose(file);
+
+        entries.clear();
+    };
+
+    // each worker replays its own share of the games, noting the key of
+    // every position along the way
+
+    std::vector<std::thread> threads;
+    for (auto worker = 0u; worker < workers; ++worker)
+    {
+        threads.emplace_back([&, worker] {
+            GameArchive games_archive;
+            if (!games_archive.open(archive_file))
+            {
+                failed = true;
+                return;
+            }
+
+            auto &board = *boards[worker];
+            PgnGame game;
+            std::vector<Entry> entries;
+            entries.reserve(run_entries);
+
+            auto first = games * worker / workers;
+            auto last = games * (worker + 1) / workers;
+            for (auto n = first; n < last && !failed; ++n)
+            {
+                if (!games_archive.read(n, game))
+                {
+                    failed = true;
+                    break;
+                }
+
+                if (!game.replay(board, 0))
+                    continue;
+
+                auto number = static_cast<std::uint32_t>(n);
+                entries.push_back(Entry{board.position_key(), number});
+                for (const auto &move : game.get_moves())
+                {
+                    board.select(board(move.from / 8, move.from % 8));
+                    board.move_selected_to(move.to / 8, move.to % 8, move.promotion);
+                    entries.push_back(Entry{board.position_key(), number});
+                }
+
+                positions += game.get_moves().size() + 1;
+                if (entries.size() >= run_entries)
+                    write_run(entries);
+            }
+
+            write_run(entries);
+        });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    // merge the runs into the index
+
+    auto output = failed ? nullptr : std::fopen(index_file.c_str(), "wb");
+    std::uint64_t written = 0;
+    if (output)
+    {
+        unsigned char header[header_size] = {'O', 'C', 'P', 'I'};
+        write_le(header + 4, index_version, 2);
+        std::fwrite(header, 1, header_size, output);
+
+        std::vector<std::unique_ptr<RunReader>> readers;
+        for (const auto &run : runs)
+        {
+            auto file = std::fopen(run.c_str(), "rb");
+            if (!file)
+            {
+                failed = true;
+                break;
+            }
+            readers.emplace_back(new RunReader(file));
+        }
+
+        using Head = std::pair<Entry, std::size_t>;
+        auto later = [](const Head &a, const Head &b) { return b.first < a.first; };
+        std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+        for (std::size_t i = 0; i < readers.size(); ++i)
+        {
+            if (readers[i]->next())
+                heads.push(Head(readers[i]->current, i));
+        }
+
+        EntryWriter writer(output);
+        Entry last{0, 0};
+        while (!heads.empty() && !failed)
+        {
+            auto head = heads.top();
+            heads.pop();
+
+            if (!writer.count || !(head.first == last))
+                failed = !writer.put(head.first);
+            last = head.first;
+
+            if (readers[head.second]->next())
+                heads.push(Head(readers[head.second]->current, head.second));
+        }
+
+        written = writer.count;
+        if (!writer.flush())
+            failed = true;
+
+        write_le(header + 8, written, 8);
+        if (std::fseek(output, 0, SEEK_SET) || std::fwrite(header, 1, header_size, output) != header_size)
+            failed = true;
+        if (std::fclose(output))
+            failed = true;
+    }
+
+    for (const auto &run : runs)
+        std::remove(run.c_str());
+
+    if (failed || !output)
+    {
+        osg::notify(osg::WARN) << "Failed building position index '" << index_file << "'." << std::endl;
+        return 1;
+    }
+
+    auto elapsed = timer->delta_s(start, timer->tick());
+    std::cout << games << " games, " << positions << " positions (" << written << " entries) indexed in " << std::fixed
+              << std::setprecision(2) << elapsed << " s on " << workers << " workers; index is "
+              << ((header_size + written * entry_size) / (1024. * 1024.)) << " MB" << std::endl;
+
+    return 0;
+}
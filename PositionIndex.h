@@ -0,0 +1,79 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Chessboard.h"
+#include "MappedFile.h"
+
+// PositionIndex -- which archived games (see GameArchive) reach a given
+// position.  The index file is a 16-byte header ("OCPI", a u16 version,
+// two spare bytes and a u64 entry count), then 12-byte entries -- a u64
+// position key (Chessboard::position_key()) and a u32 game number, both
+// little-endian -- sorted by key and then game.  The file is mapped into
+// memory rather than read, so opening it is instant, and a query only
+// touches the pages its binary search lands on.
+
+class PositionIndex
+{
+public:
+    PositionIndex() {}
+    ~PositionIndex();
+
+    bool open(const std::string &path);
+    void close();
+
+    std::uint64_t size() const
+    {
+        return entries;
+    }
+
+    // the games reaching the position (the first limit of them, in game
+    // order); returns how many there are in all
+    std::size_t find(std::uint64_t key, std::vector<std::uint32_t> &games, std::size_t limit = SIZE_MAX) const;
+    std::size_t find(const Chessboard &board, std::vector<std::uint32_t> &games, std::size_t limit = SIZE_MAX) const
+    {
+        return find(board.position_key(), games, limit);
+    }
+
+protected:
+    PositionIndex(const PositionIndex &) = delete;
+    PositionIndex &operator=(const PositionIndex &) = delete;
+
+    std::uint64_t key_at(std::uint64_t i) const;
+    std::uint32_t game_at(std::uint64_t i) const;
+
+    MappedFile file;
+    std::uint64_t entries{0};
+};
+
+// index every position of every game in an archive, replaying the games on
+// the given number of workers (0 for one per core).  Entries are sorted in
+// runs of bounded size and merged, so the archive may be much larger than
+// memory.
+int build_position_index(const std::string &archive_file, const std::string &index_file, unsigned int workers);
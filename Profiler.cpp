@@ -0,0 +1,134 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <fstream>
+#include <map>
+
+#include "Profiler.h"
+
+// a long session shouldn't be able to exhaust memory
+static const std::size_t max_trace_events = 1000000;
+
+static const char *counter_names[] = {"Frame",      "Animation",     "Attack markers", "Picking",
+                                      "Mesh picks", "Highlighting",  "Move generation", "Scene rebuild"};
+
+Profiler &Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+const char *Profiler::name(Counter counter)
+{
+    return counter_names[counter];
+}
+
+Profiler::Profiler() : origin(osg::Timer::instance()->tick())
+{
+    for (auto &ticks : frame_ticks)
+        ticks = 0;
+}
+
+void Profiler::record(Counter counter, osg::Timer_t start, osg::Timer_t end)
+{
+    frame_ticks[counter] += end - start;
+
+    if (!tracing)
+        return;
+
+    std::lock_guard<std::mutex> guard(trace_lock);
+    if (events.size() < max_trace_events)
+    {
+        TraceEvent event = {counter, start, end, std::this_thread::get_id()};
+        events.push_back(event);
+    }
+}
+
+void Profiler::add_stats_lines(osgViewer::StatsHandler *handler) const
+{
+    // OSG already shows the frame time itself
+    for (auto counter = static_cast<int>(Animation); counter < CounterCount; ++counter)
+    {
+        std::string label = counter_names[counter];
+        handler->addUserStatsLine(label + ":", osg::Vec4(0.9f, 0.9f, 0.2f, 1.f), osg::Vec4(0.9f, 0.9f, 0.2f, 0.5f),
+                                  label + " time taken", 1000.0, true, false, "", "", 10.0);
+    }
+}
+
+void Profiler::end_frame(osg::Stats *stats, unsigned int frame_number)
+{
+    auto timer = osg::Timer::instance();
+
+    for (auto counter = 0; counter < CounterCount; ++counter)
+    {
+        auto ticks = frame_ticks[counter].exchange(0);
+        if (stats)
+            stats->setAttribute(frame_number, std::string(counter_names[counter]) + " time taken",
+                                timer->delta_s(0, ticks));
+    }
+}
+
+void Profiler::start_trace()
+{
+    std::lock_guard<std::mutex> guard(trace_lock);
+    events.clear();
+    tracing = true;
+}
+
+bool Profiler::write_trace(const std::string &file_name)
+{
+    std::lock_guard<std::mutex> guard(trace_lock);
+    tracing = false;
+
+    std::ofstream output(file_name.c_str());
+    if (!output)
+    {
+        osg::notify(osg::WARN) << "Can't write trace file '" << file_name << "'." << std::endl;
+        return false;
+    }
+
+    // Chrome wants small integer thread ids
+    std::map<std::thread::id, int> thread_ids;
+
+    auto timer = osg::Timer::instance();
+
+    output << "{\"traceEvents\":[\n";
+    for (std::size_t i = 0; i < events.size(); ++i)
+    {
+        const auto &event = events[i];
+
+        auto thread = thread_ids.insert(std::make_pair(event.thread, static_cast<int>(thread_ids.size()) + 1)).first->second;
+
+        output << (i ? ",\n" : "") << "{\"name\":\"" << counter_names[event.counter] << "\",\"cat\":\"osg_chess\",\"ph\":\"X\""
+               << ",\"ts\":" << timer->delta_u(origin, event.start) << ",\"dur\":" << timer->delta_u(event.start, event.end)
+               << ",\"pid\":1,\"tid\":" << thread << "}";
+    }
+    output << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    if (events.size() >= max_trace_events)
+        osg::notify(osg::WARN) << "Trace was truncated at " << max_trace_events << " events." << std::endl;
+
+    events.clear();
+    return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "OSG.h"
+
+// Profiler -- timing scopes for the program's own subsystems.  Each frame
+// the time spent in every subsystem is published into the viewer's stats,
+// where osgViewer::StatsHandler shows it alongside OSG's own timings.
+// While a trace is being recorded, every scope is also kept as an event
+// that can be written out in Chrome's trace-event JSON format (load it in
+// chrome://tracing or Perfetto).
+
+class Profiler
+{
+public:
+    enum Counter
+    {
+        Frame,
+        Animation,
+        AttackMarkers,
+        Picking,
+        MeshIntersection,
+        Highlighting,
+        MoveGeneration,
+        SceneRebuild,
+
+        CounterCount
+    };
+
+public:
+    static Profiler &instance();
+    static const char *name(Counter counter);
+
+    void record(Counter counter, osg::Timer_t start, osg::Timer_t end);
+
+    // add an overlay line for each subsystem to a stats handler
+    void add_stats_lines(osgViewer::StatsHandler *handler) const;
+
+    // publish the frame's totals into the viewer's stats, and start over
+    void end_frame(osg::Stats *stats, unsigned int frame_number);
+
+    void start_trace();
+    bool write_trace(const std::string &file_name);
+
+protected:
+    struct TraceEvent
+    {
+        Counter counter;
+        osg::Timer_t start;
+        osg::Timer_t end;
+        std::thread::id thread;
+    };
+
+    osg::Timer_t origin;
+    std::atomic<osg::Timer_t> frame_ticks[CounterCount];
+
+    std::atomic<bool> tracing{false};
+    std::mutex trace_lock;
+    std::vector<TraceEvent> events;
+
+    Profiler();
+};
+
+// ProfileScope -- times the enclosing block
+
+class ProfileScope
+{
+public:
+    ProfileScope(Profiler::Counter counter_) : counter(counter_), start(osg::Timer::instance()->tick()) {}
+    ~ProfileScope()
+    {
+        Profiler::instance().record(counter, start, osg::Timer::instance()->tick());
+    }
+
+protected:
+    Profiler::Counter counter;
+    osg::Timer_t start;
+};
@@ -0,0 +1,372 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstdlib>
+#include <initializer_list>
+
+#include "Rules.h"
+
+static const int knight_jumps[][2] = {{1, 2}, {1, -2}, {2, 1}, {2, -1}, {-1, 2}, {-1, -2}, {-2, 1}, {-2, -1}};
+
+static const Rules::Rank major_ranks[] = {Rules::Rook, Rules::Knight, Rules::Bishop, Rules::Queen,
+                                          Rules::King, Rules::Bishop, Rules::Knight, Rules::Rook};
+
+void Rules::start(Board &board)
+{
+    for (auto &cell : board.cells)
+        cell = Empty;
+
+    for (auto col = 0; col < 8; ++col)
+    {
+        board.cells[col] = piece(major_ranks[col], White);
+        board.cells[8 + col] = piece(Pawn, White);
+        board.cells[48 + col] = piece(Pawn, Black);
+        board.cells[56 + col] = piece(major_ranks[col], Black);
+    }
+
+    board.to_move = White;
+    board.castling = AllCastling;
+    board.en_passant = -1;
+    board.reserved = 0;
+    board.halfmove_clock = 0;
+    board.fullmove_number = 1;
+}
+
+Rules::MoveMask Rules::valid_moves(const Board &board, int row, int col)
+{
+    MoveMask mask;
+
+    if (row < 0 || row > 7 || col < 0 || col > 7)
+        return mask;
+
+    auto rank = rank_at(board, row, col);
+    if (rank == Empty)
+        return mask;
+
+    auto side = side_at(board, row, col);
+
+    // record a target cell; returns true if a sliding piece may continue
+    // past it (i.e., it was empty)
+    auto target = [&](int r, int c) -> bool {
+        if (r < 0 || r > 7 || c < 0 || c > 7)
+            return false;
+
+        auto occupant = board.cells[r * 8 + c];
+        if (occupant == Empty)
+        {
+            mask.moves |= cell_bit(r, c);
+            return true;
+        }
+
+        if ((occupant >> 3) != side)
+            mask.captures |= cell_bit(r, c);
+        return false;
+    };
+
+    auto slide = [&](int dr, int dc) {
+        for (auto r = row + dr, c = col + dc; target(r, c); r += dr, c += dc)
+            ;
+    };
+
+    switch (rank)
+    {
+        case Pawn:
+        {
+            // White moves in increasing rows, Black in decreasing; a pawn
+            // still on its starting rank hasn't moved
+            auto dir = (side == White) ? 1 : -1;
+            auto r = row + dir;
+            if (r < 0 || r > 7)
+                break;
+
+            if (board.cells[r * 8 + col] == Empty)
+            {
+                mask.moves |= cell_bit(r, col);
+
+                auto r2 = r + dir;
+                if (row == ((side == White) ? 1 : 6) && board.cells[r2 * 8 + col] == Empty)
+                    mask.moves |= cell_bit(r2, col);
+            }
+
+            for (auto c : {col - 1, col + 1})
+            {
+                if (c < 0 || c > 7)
+                    continue;
+                auto occupant = board.cells[r * 8 + c];
+                if ((occupant != Empty && (occupant >> 3) != side) || board.en_passant == r * 8 + c)
+                    mask.captures |= cell_bit(r, c);
+            }
+            break;
+        }
+
+        case Knight:
+        {
+            for (const auto &jump : knight_jumps)
+                target(row + jump[0], col + jump[1]);
+            break;
+        }
+
+        case King:
+        {
+            for (auto dr = -1; dr <= 1; ++dr)
+                for (auto dc = -1; dc <= 1; ++dc)
+                    if (dr || dc)
+                        target(row + dr, col + dc);
+
+            // castling: two cells toward a rook that still has its right,
+            // over empty cells, and neither out of nor through an attack
+            // (legal_moves() checks the cell the king lands on)
+
+            auto home = (side == White) ? 0 : 7;
+            auto kingside = (side == White) ? WhiteKingside : BlackKingside;
+            auto queenside = (side == White) ? WhiteQueenside : BlackQueenside;
+            auto enemy = (side == White) ? Black : White;
+
+            if (row != home || col != 4 || !(board.castling & (kingside | queenside)) || is_attacked(board, home, 4, enemy))
+                break;
+
+            auto empty = [&](int c) { return board.cells[home * 8 + c] == Empty; };
+
+            if ((board.castling & kingside) && empty(5) && empty(6) && !is_attacked(board, home, 5, enemy))
+                mask.moves |= cell_bit(home, 6);
+            if ((board.castling & queenside) && empty(1) && empty(2) && empty(3) && !is_attacked(board, home, 3, enemy))
+                mask.moves |= cell_bit(home, 2);
+            break;
+        }
+
+        case Queen:
+        case Rook:
+        case Bishop:
+        {
+            if (rank != Bishop)
+            {
+                slide(1, 0);
+                slide(-1, 0);
+                slide(0, 1);
+                slide(0, -1);
+            }
+            if (rank != Rook)
+            {
+                slide(1, 1);
+                slide(1, -1);
+                slide(-1, 1);
+                slide(-1, -1);
+            }
+            break;
+        }
+    }
+
+    return mask;
+}
+
+// try each move on a copy of the board (all 72 bytes of it), and see if
+// the mover's king is left attacked
+
+Rules::MoveMask Rules::legal_moves(const Board &board, int row, int col)
+{
+    auto mask = valid_moves(board, row, col);
+    if (!(mask.moves | mask.captures))
+        return mask;
+
+    auto side = side_at(board, row, col);
+
+    for (auto targets : {&mask.moves, &mask.captures})
+    {
+        for (auto bits = *targets; bits; bits &= bits - 1)
+        {
+            auto index = 0;
+            while (!(bits & (std::uint64_t(1) << index)))
+                ++index;
+
+            Board after = board;
+            make_move(after, row, col, index / 8, index % 8);
+            if (in_check(after, side))
+                *targets &= ~(std::uint64_t(1) << index);
+        }
+    }
+
+    return mask;
+}
+
+bool Rules::is_legal(const Board &board, int from_row, int from_col, int to_row, int to_col)
+{
+    auto mask = valid_moves(board, from_row, from_col);
+    if (!((mask.moves | mask.captures) & cell_bit(to_row, to_col)))
+        return false;
+
+    Board after = board;
+    make_move(after, from_row, from_col, to_row, to_col);
+    return !in_check(after, side_at(board, from_row, from_col));
+}
+
+bool Rules::can_move(const Board &board)
+{
+    for (auto index = 0; index < 64; ++index)
+    {
+        if (board.cells[index] == Empty || (board.cells[index] >> 3) != board.to_move)
+            continue;
+
+        auto mask = legal_moves(board, index / 8, index % 8);
+        if (mask.moves | mask.captures)
+            return true;
+    }
+
+    return false;
+}
+
+bool Rules::is_attacked(const Board &board, int row, int col, int by)
+{
+    auto holds = [&](int r, int c, int rank) {
+        if (r < 0 || r > 7 || c < 0 || c > 7)
+            return false;
+        return board.cells[r * 8 + c] == piece(rank, by);
+    };
+
+    // the first piece met looking along a line, if it's one of ours
+    auto slider = [&](int dr, int dc, int rank) {
+        for (auto r = row + dr, c = col + dc; r >= 0 && r <= 7 && c >= 0 && c <= 7; r += dr, c += dc)
+        {
+            auto occupant = board.cells[r * 8 + c];
+            if (occupant == Empty)
+                continue;
+            return occupant == piece(rank, by) || occupant == piece(Queen, by);
+        }
+        return false;
+    };
+
+    // White's pawns attack toward increasing rows, so they sit below
+    auto pawn_row = (by == White) ? row - 1 : row + 1;
+    if (holds(pawn_row, col - 1, Pawn) || holds(pawn_row, col + 1, Pawn))
+        return true;
+
+    for (const auto &jump : knight_jumps)
+    {
+        if (holds(row + jump[0], col + jump[1], Knight))
+            return true;
+    }
+
+    for (auto dr = -1; dr <= 1; ++dr)
+    {
+        for (auto dc = -1; dc <= 1; ++dc)
+        {
+            if (!dr && !dc)
+                continue;
+            if (holds(row + dr, col + dc, King))
+                return true;
+            if (slider(dr, dc, (dr && dc) ? Bishop : Rook))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+bool Rules::in_check(const Board &board, int side)
+{
+    auto king = piece(King, side);
+    auto enemy = (side == White) ? Black : White;
+    for (auto index = 0; index < 64; ++index)
+    {
+        if (board.cells[index] == king)
+            return is_attacked(board, index / 8, index % 8, enemy);
+    }
+
+    return false;
+}
+
+// the castling right that depends on a rook standing in this corner
+
+static std::uint8_t castling_lost_at(int row, int col)
+{
+    if (row == 0 && col == 0)
+        return Rules::WhiteQueenside;
+    if (row == 0 && col == 7)
+        return Rules::WhiteKingside;
+    if (row == 7 && col == 0)
+        return Rules::BlackQueenside;
+    if (row == 7 && col == 7)
+        return Rules::BlackKingside;
+    return 0;
+}
+
+int Rules::make_move(Board &board, int from_row, int from_col, int to_row, int to_col, int promotion)
+{
+    auto &from = board.cells[from_row * 8 + from_col];
+    auto &to = board.cells[to_row * 8 + to_col];
+
+    auto mover = from & 7;
+    auto side = from >> 3;
+    auto capture = (to != Empty);
+
+    // a pawn moving diagonally onto an empty cell takes en passant; the
+    // pawn it takes stands beside that cell
+    if (mover == Pawn && to_col != from_col && !capture)
+    {
+        auto &passed = board.cells[from_row * 8 + to_col];
+        capture = (passed != Empty);
+        passed = Empty;
+    }
+
+    // castling rights go with a king or rook leaving home, or a rook being
+    // taken there
+    board.castling &= ~(castling_lost_at(from_row, from_col) | castling_lost_at(to_row, to_col));
+    if (mover == King)
+        board.castling &= (side == White) ? ~(WhiteKingside | WhiteQueenside) : ~(BlackKingside | BlackQueenside);
+
+    board.en_passant = -1;
+    if (mover == Pawn && std::abs(to_row - from_row) == 2)
+        board.en_passant = static_cast<std::int8_t>(((to_row + from_row) / 2) * 8 + to_col);
+
+    if (mover == Pawn || capture)
+        board.halfmove_clock = 0;
+    else
+        ++board.halfmove_clock;
+
+    if (side == Black)
+        ++board.fullmove_number;
+
+    to = from;
+    from = Empty;
+
+    auto promoted = static_cast<int>(Empty);
+    if (mover == Pawn && (to_row == 0 || to_row == 7))
+    {
+        promoted = (promotion == Rook || promotion == Knight || promotion == Bishop) ? promotion : Queen;
+        to = piece(promoted, side);
+    }
+
+    // castling: the king has moved two cells, and the rook hops over it
+    if (mover == King && std::abs(to_col - from_col) == 2)
+    {
+        auto rook_col = (to_col == 6) ? 7 : 0;
+        auto rook_to = (to_col == 6) ? 5 : 3;
+
+        board.cells[to_row * 8 + rook_to] = board.cells[to_row * 8 + rook_col];
+        board.cells[to_row * 8 + rook_col] = Empty;
+    }
+
+    board.to_move = (side == White) ? Black : White;
+
+    return promoted;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+
+// Rules -- the moves of chess, played on a Rules::Board: a byte for each
+// cell and the few fields a FEN record adds, with none of the names and
+// meshes a Chessboard carries.  A Chessboard keeps one of these beside its
+// pieces and asks it what may move where; the game server holds nothing
+// else, so it links without the scene (or OSG).
+
+class Rules
+{
+public:
+    // as Chessboard::Piece::Rank and Chessboard::Side, which convert to these
+    enum Rank : std::uint8_t
+    {
+        Empty,
+        Rook,
+        Knight,
+        Bishop,
+        King,
+        Queen,
+        Pawn
+    };
+
+    enum Side : std::uint8_t
+    {
+        Black = 1,
+        White
+    };
+
+    // as Chessboard::Castling
+    enum Castling : std::uint8_t
+    {
+        WhiteKingside = 1,
+        WhiteQueenside = 2,
+        BlackKingside = 4,
+        BlackQueenside = 8,
+        AllCastling = 15
+    };
+
+    // MoveMask -- the cells a piece may move to, one bit per board
+    // cell (see cell_bit())
+
+    struct MoveMask
+    {
+        std::uint64_t moves{0};     // empty cells
+        std::uint64_t captures{0};  // cells holding an opposing piece (or the en passant cell)
+    };
+
+    static std::uint64_t cell_bit(int row, int col)
+    {
+        return std::uint64_t(1) << (row * 8 + col);
+    }
+
+    // Board -- a position in 72 bytes.  Each cell holds the rank of its
+    // piece in the low three bits and the side above them (0 when empty);
+    // cells are row * 8 + col, with row 0 being rank 1.
+
+    struct Board
+    {
+        std::uint8_t cells[64];
+        std::uint8_t to_move;           // Side
+        std::uint8_t castling;          // Castling bits
+        std::int8_t en_passant;         // the cell passed over by a double step, or -1
+        std::uint8_t reserved;
+        std::uint16_t halfmove_clock;   // plies since the last capture or pawn move
+        std::uint16_t fullmove_number;  // starts at 1, and counts up after each Black move
+    };
+
+    static std::uint8_t piece(int rank, int side)
+    {
+        return static_cast<std::uint8_t>(rank | (side << 3));
+    }
+    static int rank_at(const Board &board, int row, int col)
+    {
+        return board.cells[row * 8 + col] & 7;
+    }
+    static int side_at(const Board &board, int row, int col)
+    {
+        return board.cells[row * 8 + col] >> 3;
+    }
+
+    // the opening position
+    static void start(Board &board);
+
+    static MoveMask valid_moves(const Board &board, int row, int col);
+
+    // valid_moves(), less any that would leave the mover's king attacked
+    static MoveMask legal_moves(const Board &board, int row, int col);
+
+    // can the piece on the first cell move to the second?
+    static bool is_legal(const Board &board, int from_row, int from_col, int to_row, int to_col);
+
+    // does the side to move have any legal move at all?
+    static bool can_move(const Board &board);
+
+    // is the cell attacked by a piece of the given side?
+    static bool is_attacked(const Board &board, int row, int col, int by);
+    static bool in_check(const Board &board, int side);
+
+    // make a move (legal or not; see is_legal()), keeping the castling
+    // rights, en passant cell and clocks current.  A pawn reaching the far
+    // rank becomes the promotion rank (a queen, rook, bishop or knight;
+    // anything else gives a queen).  Returns the rank it promoted to, or
+    // Empty.
+    static int make_move(Board &board, int from_row, int from_col, int to_row, int to_col, int promotion = Queen);
+};
@@ -0,0 +1,92 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+
+#include "Simul.h"
+
+// distance between board centers; a board is 0.4 units across, plus the
+// capture cells and attack markers on either side
+static const double board_spacing = 0.7;
+
+Simul::Simul(int boards, LodBuilderPtr lod_builder)
+{
+    root = new osg::Group;
+    root->setName("Simul");
+    root->setDataVariance(osg::Object::STATIC);
+
+    if (boards < 1)
+        boards = 1;
+
+    columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(boards))));
+    rows = (boards + columns - 1) / columns;
+
+    for (auto i = 0; i < boards; ++i)
+    {
+        auto row = i / columns;
+        auto col = i % columns;
+
+        osg::Vec3d position((col - (columns - 1) / 2.) * board_spacing, ((rows - 1) / 2. - row) * board_spacing, 0.);
+
+        GamePtr game(new Game(lod_builder));
+        games.push_back(game);
+
+        osg::ref_ptr<osg::MatrixTransform> mt(new osg::MatrixTransform(osg::Matrix::translate(position)));
+        mt->setName("Simul.Board");
+        mt->setDataVariance(osg::Object::STATIC);
+        mt->addChild(game->get_root_node().get());
+
+        root->addChild(mt.get());
+    }
+}
+
+void Simul::get_home_position(osg::Vec3d &eye, osg::Vec3d &center, osg::Vec3d &up) const
+{
+    // the single board's view, pulled back to fit the grid
+    auto scale = static_cast<double>(std::max(columns, rows));
+
+    center.set(0., 0., 0.);
+    eye = center + osg::Vec3d(0.5, -0.5, 1.) * scale;
+    up.set(0., 0., 1.);
+}
+
+osg::Matrix Simul::get_home_view() const
+{
+    osg::Vec3d eye, center, up;
+    get_home_position(eye, center, up);
+
+    osg::Matrix lookAt;
+    lookAt.makeLookAt(eye, center, up);
+    return lookAt;
+}
+
+bool Simul::needs_frame()
+{
+    // ask every game, so that each one's pending request is consumed
+    auto needed = false;
+    for (auto &game : games)
+        needed = game->needs_frame() || needed;
+    return needed;
+}
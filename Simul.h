@@ -0,0 +1,69 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <vector>
+
+#include "OSG.h"
+#include "Game.h"
+
+// Simul -- a wall of boards: any number of games laid out in a grid under
+// one root, for showing a simul or a tournament in a single view.  The
+// games share their meshes (Chessboard's asset map) and simplified
+// versions of them (one LodBuilder), so each extra board costs little
+// more than its transforms; boards outside the view are culled as usual,
+// and distant ones fall back to their coarser levels of detail.
+
+class Simul : public osg::Referenced
+{
+public:
+    Simul(int boards, LodBuilderPtr lod_builder);
+
+    NodePtr get_root_node() const
+    {
+        return root;
+    }
+
+    const std::vector<GamePtr> &get_games() const
+    {
+        return games;
+    }
+
+    // a view taking in the whole grid
+    osg::Matrix get_home_view() const;
+    void get_home_position(osg::Vec3d &eye, osg::Vec3d &center, osg::Vec3d &up) const;
+
+    // true if any of the boards needs drawing (see Game::needs_frame())
+    bool needs_frame();
+
+protected:
+    osg::ref_ptr<osg::Group> root;
+    std::vector<GamePtr> games;
+
+    int columns{1};
+    int rows{1};
+};
+
+using SimulPtr = osg::ref_ptr<Simul>;
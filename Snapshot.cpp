@@ -0,0 +1,74 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+
+#include "Snapshot.h"
+
+// pieces rest on the board's surface
+static const double piece_height = 0.020;
+
+BoardSnapshot::BoardSnapshot(const Chessboard &board, const Chessboard::MoveMask &highlights_, unsigned int layout_) :
+    layout(layout_), local_side(board.local_side()), highlights(highlights_)
+{
+    placements.reserve(32);
+
+    board.for_each_piece([this](const Chessboard::Piece &piece, const Chessboard::Cell &cell) {
+        auto center = cell.get_center();
+
+        Placement placement;
+        placement.id = piece.get_id();
+        placement.name = piece.get_name();
+        placement.rank = piece.get_rank();
+        placement.position.set(center.x, center.y, piece_height);
+        placement.facing = piece.get_facing();
+        placement.held = (cell.type == Chessboard::Cell::Type::Holding);
+        placement.mesh = piece.get_mesh();
+
+        placements.push_back(placement);
+    });
+
+    // a piece keeps its index for as long as the layout stays the same
+    std::sort(placements.begin(), placements.end(),
+              [](const Placement &a, const Placement &b) { return a.id < b.id; });
+}
+
+void SnapshotExchange::publish(BoardSnapshotPtr snapshot)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    back = snapshot;
+    pending = true;
+}
+
+bool SnapshotExchange::latch()
+{
+    if (!pending)
+        return false;
+
+    std::lock_guard<std::mutex> guard(lock);
+    front = back;
+    back = nullptr;
+    pending = false;
+    return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "OSG.h"
+#include "Chessboard.h"
+
+// BoardSnapshot -- an immutable copy of the board, as far as drawing it is
+// concerned.  Game logic builds one after every change and publishes it
+// through a SnapshotExchange; the update traversal applies the newest one
+// to the scene graph.  Nothing on the rendering side reads the Chessboard
+// itself, so the board may be changed on a thread other than the viewer's,
+// and cull and draw may run on threads of their own.
+
+class BoardSnapshot : public osg::Referenced
+{
+public:
+    struct Placement
+    {
+        int id;
+        std::string name;
+        Chessboard::Piece::Rank rank;
+        osg::Vec3d position;
+        float facing;
+        bool held;          // in a holding cell (i.e., captured)
+        NodePtr mesh;
+    };
+
+public:
+    BoardSnapshot(const Chessboard &board, const Chessboard::MoveMask &highlights_, unsigned int layout_);
+
+    // changes whenever the set of pieces does (see Chessboard::Listener::board_reset())
+    unsigned int layout;
+
+    Chessboard::Side local_side;
+    Chessboard::MoveMask highlights;
+
+    // every piece, on the board or captured, sorted by id
+    std::vector<Placement> placements;
+};
+
+using BoardSnapshotPtr = osg::ref_ptr<const BoardSnapshot>;
+
+// SnapshotExchange -- double-buffers the snapshots.  publish() may be
+// called from any thread, and replaces whatever is pending; latch() makes
+// the pending snapshot current once per frame, at the start of the update
+// traversal.  The current snapshot then stays put for the rest of that
+// frame, whatever the game logic does meanwhile.
+
+class SnapshotExchange
+{
+public:
+    void publish(BoardSnapshotPtr snapshot);
+
+    // true if a newer snapshot became current
+    bool latch();
+
+    BoardSnapshotPtr current() const
+    {
+        return front;
+    }
+
+protected:
+    std::mutex lock;
+    std::atomic<bool> pending{false};   // lets latch() skip the lock on idle frames
+    BoardSnapshotPtr back;      // published, but not yet latched
+    BoardSnapshotPtr front;     // in use by the current frame
+};
@@ -0,0 +1,145 @@
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "Thumbnails.h"
+
+ThumbnailRenderer::ThumbnailRenderer(GamePtr game_, int width, int height) : game(game_)
+{
+    // a pbuffer needs no display surface; the FBO does the real work.
+    // this runs on Mesa's software rasterizer (llvmpipe) as well as on
+    // a GPU.
+
+    osg::ref_ptr<osg::GraphicsContext::Traits> traits(new osg::GraphicsContext::Traits);
+    traits->readDISPLAY();
+    traits->setUndefinedScreenDetailsToDefaultScreen();
+    traits->x = 0;
+    traits->y = 0;
+    traits->width = width;
+    traits->height = height;
+    traits->windowDecoration = false;
+    traits->doubleBuffer = false;
+    traits->pbuffer = true;
+
+    osg::ref_ptr<osg::GraphicsContext> gc(osg::GraphicsContext::createGraphicsContext(traits.get()));
+    if (!gc.valid())
+    {
+        osg::notify(osg::FATAL) << "Failed to create an offscreen graphics context." << std::endl;
+        return;
+    }
+
+    // nothing should be moving in a still image
+    game->set_marker_spin(false);
+
+    viewer = new osgViewer::Viewer;
+    viewer->setThreadingModel(osgViewer::ViewerBase::SingleThreaded);
+    viewer->setSceneData(game->get_root_node().get());
+
+    auto camera = viewer->getCamera();
+    camera->setGraphicsContext(gc.get());
+    camera->setViewport(0, 0, width, height);
+    camera->setProjectionMatrixAsPerspective(30., static_cast<double>(width) / height, 0.1, 10.);
+    camera->setViewMatrix(game->get_home_view());
+    camera->setClearColor(osg::Vec4(1., 1., 1., 1.));
+    camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+
+    // the frame is read back into this image after it is drawn
+    image = new osg::Image;
+    image->allocateImage(width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    camera->attach(osg::Camera::COLOR_BUFFER, image.get());
+
+    viewer->realize();
+}
+
+bool ThumbnailRenderer::render(const std::string &fen, const std::string &file_name)
+{
+    if (!valid())
+        return false;
+
+    if (!game->get_board()->set_fen(fen))
+    {
+        osg::notify(osg::WARN) << "Invalid FEN '" << fen << "'." << std::endl;
+        return false;
+    }
+
+    viewer->frame();
+
+    if (!osgDB::writeImageFile(*image, file_name))
+    {
+        osg::notify(osg::WARN) << "Failed in osgDB::writeImageFile(" << file_name << ")." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int render_thumbnails(GamePtr game, const std::string &fen_file, const std::string &output_dir,
+                      int width, int height, const std::string &extension)
+{
+    std::ifstream input(fen_file.c_str());
+    if (!input)
+    {
+        osg::notify(osg::FATAL) << "Can't open '" << fen_file << "'." << std::endl;
+        return 1;
+    }
+
+    ThumbnailRendererPtr renderer(new ThumbnailRenderer(game, width, height));
+    if (!renderer->valid())
+        return 1;
+
+    auto timer = osg::Timer::instance();
+    auto start = timer->tick();
+
+    auto line_number = 0, attempted = 0, rendered = 0;
+    std::string fen;
+    while (std::getline(input, fen))
+    {
+        ++line_number;
+
+        // the FEN parser is strict, so drop line endings from files saved
+        // on other platforms, and any trailing blanks
+        while (!fen.empty() && (fen.back() == '\r' || fen.back() == ' ' || fen.back() == '\t'))
+            fen.pop_back();
+
+        if (fen.empty())
+            continue;
+        ++attempted;
+
+        // images are named for the line the position came from
+        std::stringstream file_name;
+        file_name << output_dir << "/" << std::setw(6) << std::setfill('0') << line_number << "." << extension;
+
+        if (renderer->render(fen, file_name.str()))
+            ++rendered;
+    }
+
+    auto elapsed = timer->delta_s(start, timer->tick());
+    osg::notify(osg::NOTICE) << "Rendered " << rendered << " of " << attempted << " positions in " << elapsed << "s ("
+                             << (elapsed > 0. ? rendered / elapsed : 0.) << " per second)." << std::endl;
+
+    return (rendered == attempted) ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// MIT License
+//
+// Copyright (c) 2020 Bob Hood
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//------------------------------------------------------------------------------
+
+#include "Game.h"
+
+// ThumbnailRenderer -- renders board positions to image files without a
+// window.  One offscreen (pbuffer + FBO) context is created up front and
+// reused for every position, so batches of thousands of positions don't
+// pay for context creation each time.
+
+class ThumbnailRenderer : public osg::Referenced
+{
+public:
+    ThumbnailRenderer(GamePtr game_, int width, int height);
+
+    bool valid() const
+    {
+        return viewer.valid();
+    }
+
+    // set the board to the FEN position and write what the camera sees
+    bool render(const std::string &fen, const std::string &file_name);
+
+protected:
+    GamePtr game;
+    osg::ref_ptr<osgViewer::Viewer> viewer;
+    osg::ref_ptr<osg::Image> image;
+};
+
+using ThumbnailRendererPtr = osg::ref_ptr<ThumbnailRenderer>;
+
+// render every FEN record in a file (one per line) into the output folder,
+// naming the images by line number
+int render_thumbnails(GamePtr game, const std::string &fen_file, const std::string &output_dir,
+                      int width, int height, const std::string &extension);
@@ -29,6 +29,7 @@
 #include <map>
 #include <tuple>
 #include <cmath>
+#include <cstdint>
 
 #define M_PI 3.14159265
 
@@ -59,3 +60,19 @@ bool compare_f(T lhs, T rhs, T epsilon = static_cast<T>(0.005))
 {
     return std::fabs(lhs - rhs) < epsilon;
 }
+
+// index of the lowest set bit in a non-zero 64-bit mask
+inline int lowest_bit(std::uint64_t bits)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    auto index = 0;
+    while (!(bits & 1))
+    {
+        bits >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
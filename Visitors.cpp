@@ -24,44 +24,60 @@
 
 #include "Visitors.h"
 
-TurnOffMoveHighlights::TurnOffMoveHighlights() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+CollectGeometries::CollectGeometries() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
 
-void TurnOffMoveHighlights::apply(osg::Node &node)
+void CollectGeometries::apply(osg::Geode &geode)
 {
-    auto name = node.getName();
-    if (name.size() > 6 && name.substr(0, 7) == "Marker.")
+    for (unsigned int i = 0; i < geode.getNumDrawables(); ++i)
     {
-        auto switch_node = dynamic_cast<osg::Switch *>(&node);
-        if (switch_node)
-            switch_node->setAllChildrenOff();
+        auto geometry = dynamic_cast<osg::Geometry *>(geode.getDrawable(i));
+        if (geometry)
+            geometries.push_back(geometry);
     }
 
-    traverse(node);
+    traverse(geode);
 }
 
-TurnOnMoveHighlights::TurnOnMoveHighlights(ListStringList targets_) :
-    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), targets(targets_)
-{}
+ShareStateSets::ShareStateSets() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
 
- void TurnOnMoveHighlights::apply(osg::Node &node)
+osg::StateSet *ShareStateSets::share(osg::StateSet *state_set)
 {
-    auto name = node.getName();
-    if (name.size() > 6 && name.substr(0, 7) == "Marker.")
+    if (!state_set)
+        return nullptr;
+
+    // there are only ever a handful of these, so a linear search is fine
+    for (const auto &candidate : unique)
     {
-        // see if this name is in the targets list
-        for (const auto &lsl_iter : targets)
-        {
-            for (const auto &sl_iter : lsl_iter)
-            {
-                if (sl_iter == name)
-                {
-                    auto switch_node = dynamic_cast<osg::Switch *>(&node);
-                    if (switch_node)
-                        switch_node->setAllChildrenOn();
-                }
-            }
-        }
+        if (candidate.get() == state_set || candidate->compare(*state_set, true) == 0)
+            return candidate.get();
     }
 
+    unique.push_back(state_set);
+    return state_set;
+}
+
+void ShareStateSets::apply(osg::Node &node)
+{
+    auto state_set = node.getStateSet();
+    if (state_set)
+        node.setStateSet(share(state_set));
+
     traverse(node);
 }
+
+void ShareStateSets::apply(osg::Geode &geode)
+{
+    auto state_set = geode.getStateSet();
+    if (state_set)
+        geode.setStateSet(share(state_set));
+
+    for (unsigned int i = 0; i < geode.getNumDrawables(); ++i)
+    {
+        auto drawable = geode.getDrawable(i);
+        state_set = drawable->getStateSet();
+        if (state_set)
+            drawable->setStateSet(share(state_set));
+    }
+
+    traverse(geode);
+}
@@ -26,19 +26,33 @@
 
 #include "OSG.h"
 
-class TurnOffMoveHighlights : public osg::NodeVisitor
+// CollectGeometries -- gathers every Geometry found beneath a node
+
+class CollectGeometries : public osg::NodeVisitor
 {
 public:
-    TurnOffMoveHighlights();
-    void apply( osg::Node& node ) override;
+    CollectGeometries();
+    void apply( osg::Geode& geode ) override;
+
+    std::vector< osg::ref_ptr<osg::Geometry> >  geometries;
 };
 
-class TurnOnMoveHighlights : public osg::NodeVisitor
+// ShareStateSets -- replaces each StateSet found beneath a node with the
+// first equivalent one this visitor has seen, so that meshes loaded from
+// separate files end up sharing their state (and the render bins can
+// sort them together)
+
+class ShareStateSets : public osg::NodeVisitor
 {
 public:
-    TurnOnMoveHighlights(ListStringList targets_);
+    ShareStateSets();
     void apply( osg::Node& node ) override;
+    void apply( osg::Geode& geode ) override;
+
+    unsigned int get_num_unique() const { return static_cast<unsigned int>(unique.size()); }
 
 protected:
-    ListStringList  targets;
+    osg::StateSet* share( osg::StateSet* state_set );
+
+    std::vector< osg::ref_ptr<osg::StateSet> >  unique;
 };
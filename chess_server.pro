@@ -0,0 +1,26 @@
+TEMPLATE = app
+TARGET = chess_server
+CONFIG += console c++11 thread
+CONFIG -= app_bundle
+CONFIG -= qt
+
+# the headless game server (Linux only; it's built on epoll), which needs
+# the rules and nothing of OSG
+
+SOURCES += \
+        Chess_Server.cpp \
+        GameServer.cpp \
+        LoadGenerator.cpp \
+        Rules.cpp \
+
+HEADERS += \
+        GameServer.h \
+        LittleEndian.h \
+        LoadGenerator.h \
+        Rules.h \
+
+INTERMEDIATE_NAME = intermediate/server
+MOC_DIR = $$INTERMEDIATE_NAME/moc
+OBJECTS_DIR = $$INTERMEDIATE_NAME/obj
+RCC_DIR = $$INTERMEDIATE_NAME/rcc
+UI_DIR = $$INTERMEDIATE_NAME/ui
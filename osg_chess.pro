@@ -1,35 +1,73 @@
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++11 thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
 SOURCES += \
+        Animation.cpp \
+        Benchmarks.cpp \
         Callbacks.cpp \
         Chessboard.cpp \
         Game.cpp \
+        GameArchive.cpp \
+        GameHistory.cpp \
         Handlers.cpp \
+        LevelOfDetail.cpp \
+        MappedFile.cpp \
+        Markers.cpp \
+        MoveJournal.cpp \
+        NetPlay.cpp \
+        OpeningExplorer.cpp \
         OSG_Chess.cpp \
+        Pgn.cpp \
+        PgnPipeline.cpp \
+        PositionIndex.cpp \
+        Profiler.cpp \
+        Rules.cpp \
+        Simul.cpp \
+        Snapshot.cpp \
+        Thumbnails.cpp \
         Visitors.cpp \
 
 HEADERS += \
+        Animation.h \
+        Benchmarks.h \
         Callbacks.h \
         Chessboard.h \
         Game.h \
+        GameArchive.h \
+        GameHistory.h \
         Handlers.h \
+        LevelOfDetail.h \
+        LittleEndian.h \
+        MappedFile.h \
+        Markers.h \
+        MoveJournal.h \
+        NetPlay.h \
+        NodeTags.h \
+        OpeningExplorer.h \
         OSG.h \
+        Pgn.h \
+        PgnPipeline.h \
+        PositionIndex.h \
+        Profiler.h \
+        Rules.h \
+        Simul.h \
+        Snapshot.h \
+        Thumbnails.h \
         Types.h \
         Visitors.h \
 
 CONFIG(debug, debug|release) {
     win32 {
         INCLUDEPATH += Y:/Dev/OSG/debug/include
-        LIBS += -losgd -losgDBd -losgViewerd -losgUtild -losgGAd -losgTextd
+        LIBS += -losgd -losgDBd -losgViewerd -losgUtild -losgGAd -losgTextd -lws2_32
         LIBS += -LY:/Dev/OSG/debug/lib
     }
 } else {
     win32 {
         INCLUDEPATH += Y:/Dev/OSG/release/include
-        LIBS += -losg -losgDB -losgViewer -losgUtil -losgGA -losgText
+        LIBS += -losg -losgDB -losgViewer -losgUtil -losgGA -losgText -lws2_32
         LIBS += -LY:/Dev/OSG/release/lib
     }
 }